@@ -0,0 +1,609 @@
+#ifndef C_BIGINT_MULT_ASYNC
+#define C_BIGINT_MULT_ASYNC
+
+/*****************************************************************************
+
+  Asynchronous multiplication
+
+  A queue of multiplication jobs which is served by a fixed pool of worker
+  threads, so that a thread which cannot afford to block on a large product
+  can hand it off and be notified when it is done.
+
+  - Jobs are kept in a bounded lock-free ring buffer (the multi-producer
+    multi-consumer queue of D. Vyukov), so submitting a job never takes a
+    lock. Two semaphores count the free slots and the waiting jobs; a full
+    queue makes mbiSubmit block and mbiTrySubmit fail (backpressure).
+  - Every worker has its own scratch arena, which grows to the largest
+    product it has seen, so the multiplications themselves do not allocate.
+  - A worker which picks up a small job takes further small jobs which are
+    waiting right away, up to a batch, and completes them together.
+  - Completion is signalled by a callback on the worker thread and by a
+    flag which mbiJobWait waits for.
+  - A job with an empty product only runs its callback, which lets the
+    workers compute the lanes of a residue number system, see
+    mbiRnsParallel.
+
+  Needs POSIX threads, i.e. compile with -pthread.
+
+****************************************************************************/
+
+
+  #include "header.h"
+
+  #include <pthread.h>
+  #include <sched.h>
+  #include <semaphore.h>
+
+
+
+
+  /*********************************************/
+  /* Datatypes and constants                   */
+  /*********************************************/
+
+  /* Jobs with n1*n2 up to this are small and get batched */
+  #ifndef MBI_ASYNC_SMALL
+  #define MBI_ASYNC_SMALL (64*64)
+  #endif
+
+  /* Maximal number of small jobs in a batch */
+  #ifndef MBI_ASYNC_BATCH
+  #define MBI_ASYNC_BATCH 32
+  #endif
+
+
+  /*
+  * A multiplication job: dest = a * b with n1+n2 digits in dest. The job
+  * memory belongs to the caller and must stay valid until it is done.
+  * If n1 or n2 is zero, nothing is multiplied and only the callback runs.
+  */
+  typedef struct bigintjob {
+    bigint* dest;
+    bigintlength n1, n2;
+    const bigint *a, *b;
+    void (*callback)( struct bigintjob* job );
+    void* context;
+    int done;
+  } bigintjob;
+
+  typedef struct {
+    unsigned long sequence;
+    bigintjob* job;
+  } bigintjobcell;
+
+  struct bigintqueue;
+
+  typedef struct {
+    struct bigintqueue* queue;
+    pthread_t thread;
+    bigint* scratch;
+    bigintlength scratchsize;
+  } bigintworker;
+
+  typedef struct bigintqueue {
+
+    /* ring buffer */
+    bigintjobcell* cells;
+    unsigned long mask;
+    unsigned long enqueuepos;
+    unsigned long dequeuepos;
+
+    sem_t slots;
+    sem_t items;
+
+    /* workers */
+    bigintworker* workers;
+    unsigned int nworkers, maxworkers;
+    int stop;
+
+    /* completion */
+    unsigned long submitted;
+    unsigned long completed;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+
+  } bigintqueue;
+
+
+
+
+  /*********************************************/
+  /* Ring buffer                               */
+  /*********************************************/
+
+  /*
+  * Puts a job into the ring buffer
+  * Remark: Returns false if the buffer is full. Lock-free, any number of
+    threads may push and pop at the same time.
+  */
+  bool mbiQueuePush( bigintqueue* q, bigintjob* job )
+  {
+    unsigned long pos = __atomic_load_n( &q->enqueuepos, __ATOMIC_RELAXED );
+    bigintjobcell* cell;
+
+    for( ;; )
+    {
+      cell = &q->cells[pos & q->mask];
+      unsigned long seq = __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE );
+      long dif = (long)seq - (long)pos;
+      if( dif == 0 ){
+        if( __atomic_compare_exchange_n( &q->enqueuepos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+          break;
+      }else if( dif < 0 ){
+        return false;
+      }else{
+        pos = __atomic_load_n( &q->enqueuepos, __ATOMIC_RELAXED );
+      }
+    }
+
+    cell->job = job;
+    __atomic_store_n( &cell->sequence, pos + 1, __ATOMIC_RELEASE );
+    return true;
+  }
+
+  /*
+  * Takes a job from the ring buffer
+  * Remark: Returns NULL if the buffer is empty.
+  */
+  bigintjob* mbiQueuePop( bigintqueue* q )
+  {
+    unsigned long pos = __atomic_load_n( &q->dequeuepos, __ATOMIC_RELAXED );
+    bigintjobcell* cell;
+
+    for( ;; )
+    {
+      cell = &q->cells[pos & q->mask];
+      unsigned long seq = __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE );
+      long dif = (long)seq - (long)(pos + 1);
+      if( dif == 0 ){
+        if( __atomic_compare_exchange_n( &q->dequeuepos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+          break;
+      }else if( dif < 0 ){
+        return NULL;
+      }else{
+        pos = __atomic_load_n( &q->dequeuepos, __ATOMIC_RELAXED );
+      }
+    }
+
+    bigintjob* job = cell->job;
+    __atomic_store_n( &cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE );
+    return job;
+  }
+
+  /*
+  * Puts a job for which a producer holds a slots token
+  * Remark: The token may be posted for a slot which another worker has
+    freed while the slot at enqueuepos is still being read. The producer
+    then waits for that slot to be freed.
+  */
+  void mbiQueuePut( bigintqueue* q, bigintjob* job )
+  {
+    while( !mbiQueuePush( q, job ) )
+      sched_yield();
+  }
+
+  /*
+  * Takes a job for which a worker holds an items token
+  * Remark: With several producers the token may be posted for a job in a
+    later slot while the slot at dequeuepos is claimed but not yet written.
+    The worker then waits for that slot to be published. Returns NULL only
+    for a shutdown token.
+  */
+  bigintjob* mbiQueueTake( bigintqueue* q )
+  {
+    for( ;; )
+    {
+      bigintjob* job = mbiQueuePop( q );
+      if( job != NULL ) return job;
+      if( __atomic_load_n( &q->stop, __ATOMIC_ACQUIRE ) ) return NULL;
+      sched_yield();
+    }
+  }
+
+
+
+
+  /*********************************************/
+  /* Workers                                   */
+  /*********************************************/
+
+  /*
+  * Computes a job with the scratch arena of a worker
+  * Remark: The arena grows to the size the job needs.
+  */
+  void mbiWorkerRun( bigintworker* w, bigintjob* job )
+  {
+    if( job->n1 == 0 || job->n2 == 0 ) return;
+    bigintlength s = mbiMultiplyUnbalancedScratchSize( job->n1, job->n2 );
+    if( s > w->scratchsize ){
+      mbiFree( w->scratch, sizeof(bigint) * w->scratchsize );
+      w->scratch = mbiAlloc( sizeof(bigint) * s );
+      assert( w->scratch != NULL );
+      w->scratchsize = s;
+    }
+    mbiMultiplyUnbalancedScratch( job->dest, job->n1, job->a, job->n2, job->b, w->scratch );
+  }
+
+  /*
+  * Tells whether a job is small enough to be batched
+  * Remark: Jobs with an empty product are not batched.
+  */
+  bool mbiJobSmall( const bigintjob* job )
+  {
+    return job->n1 * job->n2 > 0 && job->n1 * job->n2 <= MBI_ASYNC_SMALL;
+  }
+
+  /*
+  * Main loop of a worker
+  * Remark: Waits for a job, takes more small jobs if the first one is
+    small, computes them and signals their completion.
+  */
+  void* mbiWorkerMain( void* arg )
+  {
+    bigintworker* w = arg;
+    bigintqueue* q = w->queue;
+    bigintjob* batch[MBI_ASYNC_BATCH];
+
+    for( ;; )
+    {
+
+      while( sem_wait( &q->items ) != 0 );
+
+      bigintjob* job = mbiQueueTake( q );
+      if( job == NULL ){
+        /* woken up for shutdown */
+        break;
+      }
+
+      unsigned int n = 0;
+      batch[n++] = job;
+
+      /* Coalesce small jobs which are already waiting */
+      while( mbiJobSmall( job ) && n < MBI_ASYNC_BATCH && sem_trywait( &q->items ) == 0 )
+      {
+        job = mbiQueueTake( q );
+        if( job == NULL ){
+          /* a shutdown token, give it back */
+          sem_post( &q->items );
+          break;
+        }
+        if( !mbiJobSmall( job ) ){
+          /* a large or empty job, give it back to the next free worker;
+             its slot is still held by this worker */
+          mbiQueuePut( q, job );
+          sem_post( &q->items );
+          break;
+        }
+        batch[n++] = job;
+      }
+
+      for( unsigned int i = 0; i < n; i++ )
+        sem_post( &q->slots );
+
+      for( unsigned int i = 0; i < n; i++ )
+      {
+        mbiWorkerRun( w, batch[i] );
+        if( batch[i]->callback != NULL ) batch[i]->callback( batch[i] );
+        __atomic_store_n( &batch[i]->done, 1, __ATOMIC_RELEASE );
+      }
+
+      pthread_mutex_lock( &q->lock );
+      q->completed += n;
+      pthread_cond_broadcast( &q->finished );
+      pthread_mutex_unlock( &q->lock );
+
+    }
+
+    return NULL;
+  }
+
+
+
+
+  /*********************************************/
+  /* Queue                                     */
+  /*********************************************/
+
+  /*
+  * Starts a queue with its workers
+  * Remark: capacity is rounded up to a power of 2. Returns false, with
+    nothing left to free, if memory or threads could not be obtained.
+  */
+  bool mbiQueueInit( bigintqueue* q, unsigned int nworkers, unsigned long capacity )
+  {
+    unsigned long size = 2;
+    while( size < capacity ) size *= 2;
+
+    q->cells   = mbiAlloc( sizeof(bigintjobcell) * size );
+    q->workers = mbiAlloc( sizeof(bigintworker) * nworkers );
+    if( q->cells == NULL || q->workers == NULL ){
+      mbiFree( q->cells, sizeof(bigintjobcell) * size );
+      mbiFree( q->workers, sizeof(bigintworker) * nworkers );
+      return false;
+    }
+
+    q->mask = size - 1;
+    for( unsigned long i = 0; i < size; i++ ) q->cells[i].sequence = i;
+    q->enqueuepos = 0;
+    q->dequeuepos = 0;
+
+    sem_init( &q->slots, 0, (unsigned int)size );
+    sem_init( &q->items, 0, 0 );
+
+    q->stop      = 0;
+    q->submitted = 0;
+    q->completed = 0;
+    pthread_mutex_init( &q->lock, NULL );
+    pthread_cond_init( &q->finished, NULL );
+
+    q->nworkers   = 0;
+    q->maxworkers = nworkers;
+    for( unsigned int i = 0; i < nworkers; i++ )
+    {
+      bigintworker* w = &q->workers[i];
+      w->queue       = q;
+      w->scratch     = NULL;
+      w->scratchsize = 0;
+      if( pthread_create( &w->thread, NULL, mbiWorkerMain, w ) != 0 ) break;
+      q->nworkers++;
+    }
+
+    if( q->nworkers == 0 ){
+      sem_destroy( &q->slots );
+      sem_destroy( &q->items );
+      pthread_mutex_destroy( &q->lock );
+      pthread_cond_destroy( &q->finished );
+      mbiFree( q->workers, sizeof(bigintworker) * nworkers );
+      mbiFree( q->cells, sizeof(bigintjobcell) * size );
+      return false;
+    }
+
+    return true;
+  }
+
+  /*
+  * Sets up a job
+  * Remark: dest points to n1+n2 digits and must not overlap with a or b.
+    callback may be NULL; it is called on the worker thread.
+  */
+  void mbiJobInit( bigintjob* job, bigint* dest, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b,
+                   void (*callback)( bigintjob* job ), void* context )
+  {
+    job->dest     = dest;
+    job->n1       = n1;
+    job->a        = a;
+    job->n2       = n2;
+    job->b        = b;
+    job->callback = callback;
+    job->context  = context;
+    job->done     = 0;
+  }
+
+  /*
+  * Hands a job over to the workers
+  * Remark: Blocks while the queue is full.
+  */
+  void mbiSubmit( bigintqueue* q, bigintjob* job )
+  {
+    job->done = 0;
+    while( sem_wait( &q->slots ) != 0 );
+    __atomic_fetch_add( &q->submitted, 1, __ATOMIC_RELAXED );
+    mbiQueuePut( q, job );
+    sem_post( &q->items );
+  }
+
+  /*
+  * Hands a job over to the workers if the queue is not full
+  * Remark: Returns false, without blocking, if the queue is full.
+  */
+  bool mbiTrySubmit( bigintqueue* q, bigintjob* job )
+  {
+    job->done = 0;
+    if( sem_trywait( &q->slots ) != 0 ) return false;
+    __atomic_fetch_add( &q->submitted, 1, __ATOMIC_RELAXED );
+    mbiQueuePut( q, job );
+    sem_post( &q->items );
+    return true;
+  }
+
+  /*
+  * Tells whether a job is done
+  * Remark: None
+  */
+  bool mbiJobDone( const bigintjob* job )
+  {
+    return __atomic_load_n( &job->done, __ATOMIC_ACQUIRE ) != 0;
+  }
+
+  /*
+  * Waits until a job is done
+  * Remark: None
+  */
+  void mbiJobWait( bigintqueue* q, const bigintjob* job )
+  {
+    if( mbiJobDone( job ) ) return;
+    pthread_mutex_lock( &q->lock );
+    while( !mbiJobDone( job ) )
+      pthread_cond_wait( &q->finished, &q->lock );
+    pthread_mutex_unlock( &q->lock );
+  }
+
+  /*
+  * Waits until all submitted jobs are done
+  * Remark: None
+  */
+  void mbiDrain( bigintqueue* q )
+  {
+    pthread_mutex_lock( &q->lock );
+    while( q->completed != __atomic_load_n( &q->submitted, __ATOMIC_RELAXED ) )
+      pthread_cond_wait( &q->finished, &q->lock );
+    pthread_mutex_unlock( &q->lock );
+  }
+
+  /*
+  * Finishes all jobs and stops the workers
+  * Remark: No jobs may be submitted during and after the call.
+  */
+  void mbiQueueShutdown( bigintqueue* q )
+  {
+    mbiDrain( q );
+
+    __atomic_store_n( &q->stop, 1, __ATOMIC_RELEASE );
+    for( unsigned int i = 0; i < q->nworkers; i++ )
+      sem_post( &q->items );
+
+    for( unsigned int i = 0; i < q->nworkers; i++ )
+    {
+      pthread_join( q->workers[i].thread, NULL );
+      mbiFree( q->workers[i].scratch, sizeof(bigint) * q->workers[i].scratchsize );
+    }
+
+    sem_destroy( &q->slots );
+    sem_destroy( &q->items );
+    pthread_mutex_destroy( &q->lock );
+    pthread_cond_destroy( &q->finished );
+    mbiFree( q->workers, sizeof(bigintworker) * q->maxworkers );
+    mbiFree( q->cells, sizeof(bigintjobcell) * ( q->mask + 1 ) );
+  }
+
+
+
+
+  /*********************************************/
+  /* Product trees                             */
+  /*********************************************/
+
+  /*
+  * Multiplies many numbers with the workers of a queue
+  * Remark: Works like mbiProductTree. The products of every level of the
+    tree are independent and are submitted as jobs, the small ones of the
+    lower levels get batched by the workers. The calling thread waits for
+    each level.
+  */
+  bigintlength mbiProductTreeParallel( bigintqueue* q, bigint* dest, bigintlength count, const bigint* operands, const bigintlength* lengths )
+  {
+
+    assert( count > 0 );
+
+    bigintlength s = mbiProductTreeSize( count, lengths );
+    bigint* buffer = mbiAlloc( sizeof(bigint) * 2*s );
+    bigintlength* offset = mbiAlloc( sizeof(bigintlength) * 2*count );
+    bigintlength* length = offset + count;
+    bigintjob* jobs = mbiAlloc( sizeof(bigintjob) * ( count/2 + 1 ) );
+    assert( buffer != NULL && offset != NULL && jobs != NULL );
+
+    bigint *from = buffer, *to = buffer + s;
+
+    bigintlength nodes = mbiProductTreeLeaves( count, operands, lengths, from, offset, length );
+    bigintlength result = 0;
+
+    if( nodes > 0 ){
+
+      while( nodes > 1 )
+      {
+        bigintlength pairs = nodes / 2;
+
+        for( bigintlength j = 0; j < pairs; j++ )
+        {
+          bigintlength o = offset[2*j];
+          mbiJobInit( &jobs[j], to + o, length[2*j], from + o, length[2*j+1], from + offset[2*j+1], NULL, NULL );
+          mbiSubmit( q, &jobs[j] );
+        }
+        if( nodes % 2 == 1 )
+          mbiCopy( length[nodes-1], to + offset[nodes-1], from + offset[nodes-1] );
+
+        for( bigintlength j = 0; j < pairs; j++ )
+        {
+          mbiJobWait( q, &jobs[j] );
+          bigintlength o = offset[2*j], l = length[2*j] + length[2*j+1];
+          while( to[o + l - 1] == 0 ) l--;
+          offset[j] = o;
+          length[j] = l;
+        }
+        if( nodes % 2 == 1 ){
+          offset[pairs] = offset[nodes-1];
+          length[pairs] = length[nodes-1];
+        }
+
+        nodes = ( nodes + 1 ) / 2;
+        bigint* t = from; from = to; to = t;
+      }
+
+      result = length[0];
+      mbiCopy( result, dest, from + offset[0] );
+    }
+
+    mbiSetZero( s - result, dest + result );
+
+    mbiFree( jobs, sizeof(bigintjob) * ( count/2 + 1 ) );
+    mbiFree( offset, sizeof(bigintlength) * 2*count );
+    mbiFree( buffer, sizeof(bigint) * 2*s );
+    return result;
+  }
+
+
+
+
+  /*********************************************/
+  /* Residue number systems                    */
+  /*********************************************/
+
+  /*
+  * A range of lanes for a worker
+  */
+  typedef struct {
+    void (*run)( void* context, unsigned int lo, unsigned int hi );
+    void* context;
+    unsigned int lo, hi;
+  } bigintlanes;
+
+  /*
+  * Callback of a job which computes a range of lanes
+  * Remark: None
+  */
+  void mbiLanesCallback( bigintjob* job )
+  {
+    bigintlanes* l = job->context;
+    l->run( l->context, l->lo, l->hi );
+  }
+
+  /*
+  * Computes the lanes of a residue number system with the workers of a queue
+  * Remark: The lanes 0 <= i < count are cut into one range for each
+    worker, and run( context, lo, hi ) computes the lanes lo <= i < hi on
+    a worker thread, e.g. by the Lanes functions at the offset lo. A whole
+    chain of operations is best done by one call, since the lanes do not
+    depend on each other until the conversion back. The calling thread
+    waits for all ranges.
+  */
+  void mbiRnsParallel( bigintqueue* q, unsigned int count, void (*run)( void* context, unsigned int lo, unsigned int hi ), void* context )
+  {
+
+    unsigned int parts = q->nworkers < count ? q->nworkers : count;
+    if( parts == 0 ) return;
+
+    bigintjob* jobs = mbiAlloc( sizeof(bigintjob) * parts );
+    bigintlanes* lanes = mbiAlloc( sizeof(bigintlanes) * parts );
+    assert( jobs != NULL && lanes != NULL );
+
+    for( unsigned int j = 0; j < parts; j++ )
+    {
+      lanes[j].run     = run;
+      lanes[j].context = context;
+      lanes[j].lo      = (unsigned int)( (unsigned long)count * j / parts );
+      lanes[j].hi      = (unsigned int)( (unsigned long)count * ( j + 1 ) / parts );
+      mbiJobInit( &jobs[j], NULL, 0, NULL, 0, NULL, mbiLanesCallback, &lanes[j] );
+      mbiSubmit( q, &jobs[j] );
+    }
+
+    for( unsigned int j = 0; j < parts; j++ )
+      mbiJobWait( q, &jobs[j] );
+
+    mbiFree( lanes, sizeof(bigintlanes) * parts );
+    mbiFree( jobs, sizeof(bigintjob) * parts );
+  }
+
+
+
+
+#endif
@@ -2,7 +2,7 @@
 /****************************************************************************
 
     Compile with: 
-	gcc -std=c99 -pedantic -W -Wall -Wformat -Wextra example.c -o example.out
+	gcc -std=c99 -pedantic -W -Wall -Wformat -Wextra -pthread example.c -o example.out
 	
 ****************************************************************************/  
 
@@ -10,21 +10,298 @@
 
 
 #include "header.h"    
+#include "async.h"
+
+  
+  /* An allocator hook which counts the bytes in use */
+  size_t hookbytes = 0;
+  
+  void* hookReallocate( void* context, void* p, size_t oldsize, size_t newsize )
+  {
+    (void)context;
+    hookbytes += newsize - oldsize;
+    return realloc( p, newsize );
+  }
+  
+  void hookRelease( void* context, void* p, size_t size )
+  {
+    (void)context;
+    hookbytes -= size;
+    free( p );
+  }
+  
+  /* A thread which submits single digit products to a shared queue */
+  typedef struct {
+    bigintqueue* queue;
+    unsigned int count;
+    bigintjob* jobs;
+    bigint* factors;
+    bigint* products;
+  } asyncproducer;
+  
+  void* asyncProducerRun( void* context )
+  {
+    asyncproducer* p = context;
+    for( unsigned int i = 0; i < p->count; i++ )
+    {
+      mbiJobInit( &p->jobs[i], p->products + 2*i, 1, p->factors + 2*i, 1, p->factors + 2*i + 1, NULL, NULL );
+      if( i % 2 == 0 || !mbiTrySubmit( p->queue, &p->jobs[i] ) )
+        mbiSubmit( p->queue, &p->jobs[i] );
+    }
+    return NULL;
+  }
+  
+  /* A chain on the lanes of a residue number system: the sum of the products of rows of factors */
+  typedef struct {
+    const bigintrns* rns;
+    unsigned int rows, cols;
+    bigint** factors;
+    bigint* sum;
+  } rnschain;
+  
+  void rnsChainRun( void* context, unsigned int lo, unsigned int hi )
+  {
+    rnschain* c = context;
+    const bigint *p = c->rns->primes + lo, *pinv = c->rns->pinv + lo;
+    unsigned int n = hi - lo;
+    bigint* t = malloc( sizeof(bigint) * n );
+    memset( c->sum + lo, 0, sizeof(bigint) * n );
+    for( unsigned int r = 0; r < c->rows; r++ )
+    {
+      memcpy( t, c->factors[r*c->cols] + lo, sizeof(bigint) * n );
+      for( unsigned int k = 1; k < c->cols; k++ )
+        mbiRnsMulLanes( n, t, t, c->factors[r*c->cols+k] + lo, p, pinv );
+      mbiRnsAddLanes( n, c->sum + lo, c->sum + lo, t, p );
+    }
+    free( t );
+  }
     
   
 
   
-  int main()
+  int main( int argc, char** argv )
   {
 
       
     printf( "Big Integer Multiplication -- Checks and Performance \n\n");
     
+    /* All test data comes from one generator, a run is repeated by its seed */
+    uint64_t seed = argc > 1 ? strtoull( argv[1], NULL, 0 ) : (uint64_t)time( NULL );
+    bigintrandom rng;
+    mbiRandomSeed( &rng, seed );
+    printf( "Seed %llu\n\n", (unsigned long long)seed );
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /*******************************/
+    
+    /*
+    * The generator is reproducible and the patterns are multiplied in all
+    * combinations, which runs the carry paths that random digits miss
+    */
+    
+    {
+      
+      printf( "Testing random numbers and patterns...\n" );
+      
+      const bigintlength lengths[] = { 1, 2, 7, 64, 300 };
+      bigint* A  = malloc( sizeof(bigint) * 300 );
+      bigint* B  = malloc( sizeof(bigint) * 300 );
+      bigint* R1 = malloc( sizeof(bigint) * 600 );
+      bigint* R2 = malloc( sizeof(bigint) * 600 );
+      
+      /* Same seed, same digits; a jumped copy gives other digits */
+      bigintrandom r1, r2;
+      mbiRandomSeed( &r1, 12345 );
+      mbiRandomSeed( &r2, 12345 );
+      mbiRandomFill( &r1, 299, A );
+      mbiRandomFill( &r2, 299, B );
+      bool ok = mbiCompare( 299, A, B ) == 0;
+      mbiRandomJump( &r2 );
+      mbiRandomFill( &r1, 299, A );
+      mbiRandomFill( &r2, 299, B );
+      ok = ok && mbiCompare( 299, A, B ) != 0;
+      
+      /* Full width digits */
+      bigint all = 0;
+      for( bigintlength i = 0; i < 299; i++ ) all |= A[i];
+      ok = ok && all == DIGIT_MAX;
+      
+      mbiRandomPattern( &rng, 300, A, MBI_PATTERN_BIT );
+      ok = ok && mbiPopCount( 300, A ) == 1;
+      
+      if( !ok ){
+        printf( "-- Error in random generator\n" );
+        return 1;
+      }
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( unsigned int j = 0; j < sizeof(lengths)/sizeof(lengths[0]); j++ )
+      for( int pa = 0; pa < MBI_PATTERNS; pa++ )
+      for( int pb = 0; pb < MBI_PATTERNS; pb++ )
+      {
+        bigintlength n1 = lengths[i], n2 = lengths[j];
+        mbiRandomPattern( &rng, n1, A, pa );
+        mbiRandomPattern( &rng, n2, B, pb );
+        
+        mbiMulBasecase( R1, n1, A, n2, B );
+        mbiMultiplyUnbalanced( R2, n1, A, n2, B );
+        ok = mbiCompare( n1 + n2, R1, R2 ) == 0;
+        
+        if( n1 == n2 && pa == pb ){
+          mbiMulBasecase( R1, n1, A, n1, A );
+          mbiSquareN( n1, R2, A );
+          ok = ok && mbiCompare( 2*n1, R1, R2 ) == 0;
+        }
+        
+        if( !ok ){
+          printf( "-- Error in product of patterns %d and %d with %lu and %lu digits\n", pa, pb, n1, n2 );
+          return 1;
+        }
+      }
+      
+      free( A ); free( B ); free( R1 ); free( R2 );
+      
+    }
+    
+    /*
+    * Bit operations are checked against digit-by-digit reference loops
+    */
+    
+    {
+      
+      printf( "Testing bit operations...\n" );
+      
+      const bigintlength l = 37; /* Odd length to exercise the vector tails */
+      const unsigned long shifts[] = { 0, 1, 17, 63, 64, 65, 128, 130, 64*36+5, 64*37, 64*40 };
+      
+      long int v = 0, vmax = 100;
+      
+      for( v = 0; v < vmax; v++ )
+      {
+        
+        bigint P[l], Q[l], R1[l], R2[l];
+        
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
+        
+        for( unsigned int t = 0; t < sizeof(shifts)/sizeof(shifts[0]); t++ )
+        {
+          unsigned long r = shifts[t];
+          
+          /* Shifting in place and shifting into a copy agree */
+          mbiCopy( l, R1, P );
+          mbiBitLeftShift( l, R1, r );
+          mbiBitLeftShiftCopy( l, R2, P, r );
+          if( mbiCompare( l, R1, R2 ) != 0 ){ printf( "-- Error in left shift by %lu\n", r ); return 1; }
+          
+          /* Shifting back restores the bits which have not been shifted out */
+          mbiBitRightShift( l, R1, r, true );
+          mbiCopy( l, R2, P );
+          mbiBitLeftShift( l, R2, r );
+          mbiBitRightShiftCopy( l, R2, R2, r );
+          if( mbiCompare( l, R1, R2 ) != 0 ){ printf( "-- Error in right shift by %lu\n", r ); return 1; }
+          
+          /* Only the low bits survive */
+          unsigned long keep = r < l*DIGIT_BITS ? l*DIGIT_BITS - r : 0;
+          mbiCopy( l, R2, P );
+          for( bigintlength i = 0; i < l; i++ )
+            if( (i+1)*DIGIT_BITS > keep )
+              R2[i] = i*DIGIT_BITS >= keep ? 0 : R2[i] & ( DIGIT_MAX >> ( (i+1)*DIGIT_BITS - keep ) );
+          if( mbiCompare( l, R1, R2 ) != 0 ){ printf( "-- Error in shift round trip by %lu\n", r ); return 1; }
+        }
+        
+        /* Logic */
+        bigint S[l];
+        mbiAnd( l, R1, P, Q );
+        mbiOr( l, R2, P, Q );
+        mbiXor( l, S, P, Q );
+        for( bigintlength i = 0; i < l; i++ )
+          if( R1[i] != ( P[i] & Q[i] ) || R2[i] != ( P[i] | Q[i] ) || S[i] != ( P[i] ^ Q[i] ) ){
+            printf( "-- Error in bitwise logic\n" );
+            return 1;
+          }
+        mbiNot( l, R1, P );
+        mbiAnd( l, R1, R1, P );
+        if( !mbiIsZero( l, R1 ) ){ printf( "-- Error in bitwise complement\n" ); return 1; }
+        
+        /* Counting, with some zero digits at both ends */
+        mbiSetZero( (bigintlength)(v % 13), P );
+        mbiSetZero( (bigintlength)(v % 11), P + l - v % 11 );
+        
+        unsigned long pop = 0;
+        for( bigintlength i = 0; i < l; i++ )
+          for( bigint d = P[i]; d != 0; d >>= 1 ) pop += d & 1;
+        
+        bigintlength bytes; unsigned long bits;
+        mbiGetNumericalLength( l, P, &bytes, &bits );
+        unsigned long lz = bytes == 0 ? l*DIGIT_BITS : (l-bytes)*DIGIT_BITS + DIGIT_BITS - bits;
+        
+        unsigned long tz = 0;
+        while( tz < l*DIGIT_BITS && ( ( P[tz/DIGIT_BITS] >> (tz%DIGIT_BITS) ) & 1 ) == 0 ) tz++;
+        
+        if( mbiPopCount( l, P ) != pop || mbiCountLeadingZeros( l, P ) != lz || mbiCountTrailingZeros( l, P ) != tz )
+        {
+          printf( "-- Error in bit counting\n" );
+          return 1;
+        }
+        
+      }
+      
+    }
     
     /*******************************/
     /* Testing of functionality    */
+    /* Memory                      */
     /*******************************/
     
+    {
+      
+      printf( "Testing memory...\n" );
+      
+      const size_t sizes[] = { 1, 100, 1000, 4096, 100000, (size_t)3 << 20, (size_t)17 << 20 };
+      
+      for( unsigned int t = 0; t < sizeof(sizes)/sizeof(sizes[0]); t++ )
+      {
+        unsigned char* p = mbiAlloc( sizes[t] );
+        if( p == NULL || (uintptr_t)p % 64 != 0 ){ printf( "-- Error in alignment of %lu bytes\n", (unsigned long)sizes[t] ); return 1; }
+        memset( p, 0xA5, sizes[t] );
+        mbiFree( p, sizes[t] );
+        
+        /* Same size class, so the block is recycled */
+        unsigned char* q = mbiAlloc( sizes[t] );
+        if( q != p ){ printf( "-- Error in recycling of %lu bytes\n", (unsigned long)sizes[t] ); return 1; }
+        
+        q = mbiRealloc( q, sizes[t], 2 * sizes[t] + 1000 );
+        for( size_t i = 0; i < sizes[t]; i++ )
+          if( q[i] != 0xA5 ){ printf( "-- Error in reallocation of %lu bytes\n", (unsigned long)sizes[t] ); return 1; }
+        mbiFree( q, 2 * sizes[t] + 1000 );
+      }
+      
+      mbiAllocTrim();
+      if( mbiAllocState.cached != 0 || mbiAllocState.mapped != 0 ){ printf( "-- Error in trimming\n" ); return 1; }
+      
+      /* All internal memory goes through the hook */
+      bigintallocator counter = { hookReallocate, hookRelease, NULL };
+      mbiAllocConfig.hook = &counter;
+      
+      bigintlength l = 3000;
+      bigint* P = malloc( sizeof(bigint) * 6 * l );
+      bigint *Q = P + l, *R = P + 2*l, *S = P + 4*l;
+      mbiRandomFill( &rng, 2*l, P );
+      
+      mbiMultiplyN( l, R, P, Q );
+      mbiMultiplikation( S, l, P, l, Q );
+      mbiMultiply( 11, S, P, Q );
+      mbiMulHi( l, S, P, Q );
+      if( hookbytes != 0 ){ printf( "-- Error with the allocator hook\n" ); return 1; }
+      
+      mbiAllocConfig.hook = NULL;
+      free( P );
+      
+    }
+    
     /*
     * For testing, we can use different patterns as control samples
     * Numbers of form 0xFFFFF...FF are suitable since one can immediatly check the result.
@@ -43,13 +320,11 @@
       for( v = 0; v < vmax; v++ )
       {
     
-        if( vmax % 127 == 0 ) srand( clock() + rand() + v );
-          
         bigint P[l], Q[l];
         bigint R1[2*l], R2[2*l];
                 
-        mbiShuffle( l, P, 0 );
-        mbiShuffle( l, Q, 0 );
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
         
         /* Naiv method */
         mbiNaivMultiplication( k, R1, P, Q );
@@ -105,8 +380,8 @@
         
         mbiSetZero( l_act, P );
         mbiSetZero( l_act, Q );
-        mbiShuffle( l_1, P, 0 );
-        mbiShuffle( l_2, Q, 0 );
+        mbiRandomFill( &rng, l_1, P );
+        mbiRandomFill( &rng, l_2, Q );
         
         mbiSetZero( l_act*2, R1 );
         mbiSetZero( l_act*2, R2 );
@@ -135,44 +410,1188 @@
     }
     
 
-    /***************/
-    /* Performance */
-    /***************/
+    /*******************************/
+    /* Testing of functionality    */
+    /* School method basecase      */
+    /*******************************/
     
     {
       
-      printf( "Performance Test....\n" );
+      printf( "Testing school method basecase...\n" );
+      
+      const bigintlength sizes[][2] = { {1,1}, {3,7}, {64,64}, {300,5}, {513,40}, {257,256} };
+      
+      for( unsigned int t = 0; t < sizeof(sizes)/sizeof(sizes[0]); t++ )
+      {
+        
+        const bigintlength l_1 = sizes[t][0], l_2 = sizes[t][1];
+        bigint *P  = malloc( sizeof(bigint) * 3 * (l_1 + l_2) );
+        bigint *Q  = P + l_1;
+        bigint *R1 = Q + l_2;
+        bigint *R2 = R1 + l_1 + l_2;
+        
+        /* The largest digits provoke the longest carry chains */
+        mbiRandomFill( &rng, l_1, P );
+        mbiSetDigits( l_2, Q, DIGIT_MAX );
+        if( t % 2 ) mbiSetDigits( l_1, P, DIGIT_MAX );
+        
+        mbiNaivMultiplication2( R1, l_1, P, l_2, Q );
+        mbiMulBasecase( R2, l_1, P, l_2, Q );
+        
+        if( mbiCompare( l_1 + l_2, R1, R2 ) != 0 )
+        {
+          printf( "-- Error in basecase with %ld and %ld digits\n", l_1, l_2 );
+          return 1;
+        }
+        
+        free( P );
+        
+      }
+      
+    }
     
-      long int t1, t2;
     
-      t1 = clock();
+    /*******************************/
+    /* Testing of functionality    */
+    /* Arbitrary lengths and       */
+    /* short products              */
+    /*******************************/
     
-      const bigintexpo k = 10;
-      const bigintlength l = 1 << k; /* Number of digits */
+    {
       
-      long int v = 0, vmax = 100;
+      printf( "Testing arbitrary length Karatsuba and short products...\n" );
       
-      /* printf( "Multiply %ld-times two numbers of length %ld\n", vmax, l ); */
-      printf( "-- %ld multiplication of two numbers of %ld digits each in base 2^32\n", vmax, l );
-      printf( "-- approx. %lld decimal digits\n", (long long) 9 * l );
-
-      /*
-      * We can use several samples:
-      * Iterate one specific multiplication
-      * A specific subset of mulitplications
-      * random numbers
-      * ...
-      */
+      for( bigintlength l = 1; l < 1200; l += 1 + l/4 )
+      {
+        
+        bigint *P  = malloc( sizeof(bigint) * l * 8 );
+        bigint *Q  = P + l;
+        bigint *R1 = Q + l;
+        bigint *R2 = R1 + 2*l;
+        bigint *R3 = R2 + 2*l;
+        
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
+        if( l % 2 ) mbiSetDigits( l, Q, DIGIT_MAX );
+        if( l % 3 ) mbiSetDigits( l, P, DIGIT_MAX );
+        
+        mbiNaivMultiplication2( R1, l, P, l, Q );
+        
+        mbiMultiplyN( l, R2, P, Q );
+        mbiMulLo( l, R3, P, Q );
+        mbiMulHi( l, R3 + l, P, Q );
+        
+        if( mbiCompare( 2*l, R1, R2 ) != 0 || mbiCompare( 2*l, R1, R3 ) != 0 )
+        {
+          printf( "-- Error in product of %ld digits\n", l );
+          printf( "-- Naiv method:\n" );
+          mbiOutput( 2*l, R1 );
+          printf( "-- Karatsuba-Ofmann:\n" );
+          mbiOutput( 2*l, R2 );
+          printf( "-- Short products:\n" );
+          mbiOutput( 2*l, R3 );
+          return 1;
+        }
+        
+        free( P );
+        
+      }
       
-      for( v = 0; v < vmax; v++ ){
+    }
     
-        bigint P[l], Q[l];
-        bigint R[2*l];
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Sparse and padded factors   */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing multiplication of sparse and padded numbers...\n" );
+      
+      const bigintexpo k = 9;
+      const bigintlength l = 1 << k;
+      
+      bigint *P  = malloc( sizeof(bigint) * l * 6 );
+      bigint *Q  = P + l;
+      bigint *R1 = Q + l;
+      bigint *R2 = R1 + 2*l;
+      
+      long int v = 0, vmax = 200;
+      
+      for( v = 0; v < vmax; v++ )
+      {
+        
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
+        
+        /* Cut out blocks of zeros, whose size and position depend on v */
+        bigintlength zp = ( l >> ( v % 8 ) ) % l, zq = ( l >> ( v / 8 % 8 ) ) % l;
+        mbiSetZero( zp, v % 2 ? P : P + l - zp );
+        mbiSetZero( zq, v % 3 ? Q + l - zq : Q );
+        if( v % 5 == 0 ) mbiSetZero( l-1, P+1 );
+        if( v % 7 == 0 ) mbiSetZero( l-1, Q+1 );
+        if( v % 50 == 0 ) mbiSetZero( l, Q );
+        
+        mbiNaivMultiplication2( R1, l, P, l, Q );
+        mbiMultiply( k, R2, P, Q );
+        
+        if( mbiCompare( l*2, R1, R2 ) != 0 )
+        {
+          printf( "-- Error occurred with sparse numbers, pattern %ld\n", v );
+          return 1;
+        }
+        
+      }
+      
+      free( P );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Prepared factors            */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing prepared factors...\n" );
+      
+      const bigintexpo k = 9;
+      const bigintlength l = 1 << k;
+      const int nconst = 5;
+      
+      bigint *C  = malloc( sizeof(bigint) * l * (nconst + 5) );
+      bigint *P  = C + nconst*l;
+      bigint *R1 = P + l;
+      bigint *R2 = R1 + 2*l;
+      
+      mbiRandomFill( &rng, nconst*l, C );
+      mbiSetDigits( l, C, DIGIT_MAX );
+      mbiSetZero( l/2, C + l + l/2 );
+      
+      /* Room for about two fully prepared factors, so entries get evicted */
+      bigintpool pool;
+      mbiPoolInit( &pool, 2 * mbiPreparedSize( k, k ) );
+      
+      long int v = 0, vmax = 60;
+      
+      for( v = 0; v < vmax; v++ )
+      {
+        
+        const bigint* b = C + ( v * v % nconst ) * l;
+        
+        mbiRandomFill( &rng, l, P );
+        if( v % 4 == 0 ) mbiSetZero( l/2, P );
+        if( v == 40 ) C[3] ^= 1; /* a changed factor is prepared again */
+        
+        mbiMultiply( k, R1, P, b );
+        mbiPoolMultiply( &pool, k, R2, P, b );
+        
+        if( mbiCompare( 2*l, R1, R2 ) != 0 || pool.used > pool.capacity )
+        {
+          printf( "-- Error with prepared factor %ld\n", (long)( b - C ) / (long)l );
+          return 1;
+        }
+        
+      }
+      
+      mbiPoolFree( &pool );
+      
+      /* A pool too small for the copy multiplies without preparing */
+      mbiPoolInit( &pool, mbiPreparedSize( k, 0 ) - 1 );
+      mbiMultiply( k, R1, P, C );
+      mbiPoolMultiply( &pool, k, R2, P, C );
+      if( mbiCompare( 2*l, R1, R2 ) != 0 || pool.count != 0 || pool.used > pool.capacity ){
+        printf( "-- Error with a pool smaller than a factor\n" );
+        return 1;
+      }
+      mbiPoolFree( &pool );
+      free( C );
+      
+    }
+    
+    /*
+    * Every budget gives the product of the school method, within the budget
+    */
+    
+    {
+      
+      printf( "Testing multiplication within a memory budget...\n" );
+      
+      const bigintlength lengths[][2] = { {1,1}, {70,70}, {300,300}, {257,1100}, {1500,900}, {2048,2048} };
+      const size_t budgets[] = { 0, 1000, 11300, 40000, 100000, (size_t)1 << 30 };
+      bigint* A  = malloc( sizeof(bigint) * 2048 );
+      bigint* B  = malloc( sizeof(bigint) * 2048 );
+      bigint* R1 = malloc( sizeof(bigint) * 4096 );
+      bigint* R2 = malloc( sizeof(bigint) * 4096 );
+      int seen[3] = { 0, 0, 0 };
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( unsigned int j = 0; j < sizeof(budgets)/sizeof(budgets[0]); j++ )
+      {
+        bigintlength n1 = lengths[i][0], n2 = lengths[i][1];
+        mbiRandomPattern( &rng, n1, A, j % MBI_PATTERNS );
+        mbiRandomFill( &rng, n2, B );
+        
+        bigintbudget report;
+        mbiMultiplyBudget( R1, n1, A, n2, B, budgets[j], &report );
+        mbiMulBasecase( R2, n1, A, n2, B );
+        seen[report.strategy]++;
         
-        srand( time(NULL) * rand() + v*v*v*v );
+        if( mbiCompare( n1+n2, R1, R2 ) != 0 || report.peak > budgets[j] ){
+          printf( "-- Error in product of %lu and %lu digits within %lu bytes\n", n1, n2, (unsigned long)budgets[j] );
+          return 1;
+        }
+      }
+      
+      if( !seen[MBI_BUDGET_KARATSUBA] || !seen[MBI_BUDGET_CHUNKED] || !seen[MBI_BUDGET_SCHOOL] ){
+        printf( "-- Error: not all budget strategies were used\n" );
+        return 1;
+      }
+      
+      free( A ); free( B ); free( R1 ); free( R2 );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Multiply-accumulate         */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing fused multiply-accumulate...\n" );
+      
+      const bigintlength lengths[][2] = { {1,1}, {3,70}, {64,64}, {65,65}, {200,137}, {300,300}, {1000,130} };
+      bigint* a = malloc( sizeof(bigint) * 1000 );
+      bigint* b = malloc( sizeof(bigint) * 1000 );
+      bigint* p = malloc( sizeof(bigint) * 1400 );
+      bigint* d = malloc( sizeof(bigint) * 1400 );
+      bigint* e = malloc( sizeof(bigint) * 1400 );
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( int pattern = 0; pattern < MBI_PATTERNS; pattern++ )
+      for( bigintlength extra = 0; extra < 3; extra += 2 )
+      {
+        bigintlength n1 = lengths[i][0], n2 = lengths[i][1], nd = n1 + n2 + extra;
+        
+        mbiRandomPattern( &rng, n1, a, pattern );
+        mbiRandomPattern( &rng, n2, b, ( pattern + 1 ) % MBI_PATTERNS );
+        mbiRandomPattern( &rng, nd, d, pattern );
+        memcpy( e, d, sizeof(bigint) * nd );
+        
+        /* d += a*b against the product added by AddInto */
+        mbiMulBasecase( p, n1, a, n2, b );
+        bool c1 = mbiAddInto( nd, e, n1 + n2, p );
+        bool c2 = mbiAddMul( nd, d, n1, a, n2, b );
+        if( c1 != c2 || memcmp( d, e, sizeof(bigint) * nd ) != 0 ){
+          printf( "-- Error in AddMul of %lu and %lu digits onto %lu digits, pattern %d\n", (unsigned long)n1, (unsigned long)n2, (unsigned long)nd, pattern );
+          return 1;
+        }
+        
+        /* d -= a*x against the multiple subtracted by Sub */
+        bigint x = b[0];
+        bool borrow = false;
+        bigint h1 = mbiMulLimb( n1, p, a, x );
+        mbiSub( n1, e, p, &borrow );
+        bigint h2 = mbiSubMulLimb( n1, d, a, x );
+        if( h1 + borrow != h2 || memcmp( d, e, sizeof(bigint) * n1 ) != 0 ){
+          printf( "-- Error in SubMulLimb of %lu digits, pattern %d\n", (unsigned long)n1, pattern );
+          return 1;
+        }
+      }
+      
+      free( a ); free( b ); free( p ); free( d ); free( e );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Polynomials                 */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing polynomial multiplication...\n" );
+      
+      const size_t lengths[][2] = { {1,1}, {1,9}, {7,7}, {50,31}, {200,200}, {1000,333} };
+      const unsigned int bits[] = { 1, 8, 20, 26 };
+      int64_t* A = malloc( sizeof(int64_t) * 1000 );
+      int64_t* B = malloc( sizeof(int64_t) * 1000 );
+      int64_t* C = malloc( sizeof(int64_t) * 2000 );
+      int64_t* D = malloc( sizeof(int64_t) * 2000 );
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( unsigned int j = 0; j < sizeof(bits)/sizeof(bits[0]); j++ )
+      for( unsigned int square = 0; square < 2; square++ )
+      {
+        size_t n1 = lengths[i][0], n2 = square ? n1 : lengths[i][1];
+        const int64_t* b = square ? A : B;
+        
+        /* coefficients of both signs up to bits[j] bits, some extreme */
+        for( size_t t = 0; t < n1; t++ ) A[t] = (int64_t)( mbiRandomDigit( &rng ) >> ( 64 - bits[j] ) ) - ( (int64_t)1 << ( bits[j] - 1 ) );
+        for( size_t t = 0; t < n2; t++ ) B[t] = (int64_t)( mbiRandomDigit( &rng ) >> ( 64 - bits[j] ) ) - ( (int64_t)1 << ( bits[j] - 1 ) );
+        A[n1-1] = -( (int64_t)1 << ( bits[j] - 1 ) );
+        if( n2 > 1 ) B[0] = 0;
+        
+        for( size_t t = 0; t < n1 + n2 - 1; t++ ) D[t] = 0;
+        for( size_t t = 0; t < n1; t++ )
+          for( size_t u = 0; u < n2; u++ )
+            D[t+u] += A[t] * b[u];
+        
+        if( !mbiPolyMul( C, n1, A, n2, b ) || memcmp( C, D, sizeof(int64_t) * ( n1 + n2 - 1 ) ) != 0 ){
+          printf( "-- Error in product of polynomials of %lu and %lu coefficients of %u bits\n", (unsigned long)n1, (unsigned long)n2, bits[j] );
+          return 1;
+        }
+      }
+      
+      /* products which do not fit into the slots are refused */
+      A[0] = (int64_t)1 << 40;
+      B[0] = (int64_t)1 << 30;
+      if( mbiPolyMul( C, 1, A, 1, B ) ){
+        printf( "-- Error: product of polynomials with too large coefficients\n" );
+        return 1;
+      }
+      
+      free( A ); free( B ); free( C ); free( D );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Big Int handles             */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing big int handles...\n" );
+      
+      const bigintlength sizes[][2] = { {1,1}, {5,17}, {33,33}, {40,300}, {129,64}, {100,1000} };
+      
+      for( unsigned int t = 0; t < sizeof(sizes)/sizeof(sizes[0]); t++ )
+      {
+        
+        const bigintlength l_1 = sizes[t][0], l_2 = sizes[t][1];
+        bigint *P = malloc( sizeof(bigint) * (2*l_1 + 2*l_2) );
+        bigint *Q = P + l_1;
+        bigint *R = Q + l_2;
+        
+        mbiRandomFill( &rng, l_1, P );
+        mbiRandomFill( &rng, l_2, Q );
+        P[l_1-1] |= 1;
+        Q[l_2-1] |= 1;
+        
+        bigintnum a, b, c, d;
+        mbiNumInit( &a, NULL );
+        mbiNumInit( &b, NULL );
+        mbiNumInit( &c, NULL );
+        mbiNumInit( &d, NULL );
+        
+        /* Leading zeros are dropped */
+        mbiNumReserve( &a, 4*l_1 );
+        mbiSetZero( 4*l_1, a.digits );
+        mbiCopy( l_1, a.digits, P );
+        mbiNumSet( &a, 4*l_1, a.digits, t % 2 == 1 );
+        mbiNumSet( &b, l_2, Q, t % 3 == 1 );
+        
+        /* Product against the school method */
+        mbiNaivMultiplication2( R, l_1, P, l_2, Q );
+        mbiNumMul( &c, &a, &b );
+        if( c.length != l_1 + l_2 - ( R[l_1+l_2-1] == 0 ) || mbiCompare( c.length, c.digits, R ) != 0
+            || c.negative != ( a.negative != b.negative ) )
+        {
+          printf( "-- Error in handle product of %ld and %ld digits\n", l_1, l_2 );
+          return 1;
+        }
+        
+        /* (a + b) - b = a, also in place */
+        mbiNumAdd( &d, &a, &b );
+        mbiNumSub( &d, &d, &b );
+        if( mbiNumCompare( &d, &a ) != 0 ){ printf( "-- Error in handle addition\n" ); return 1; }
+        
+        /* b - (a + b) = -a */
+        mbiNumAdd( &d, &a, &b );
+        mbiNumSub( &d, &b, &d );
+        d.negative = !d.negative;
+        if( mbiNumCompare( &d, &a ) != 0 ){ printf( "-- Error in handle subtraction\n" ); return 1; }
+        
+        /* a*b - b*a = 0, a*a = a*(a+a)/2 */
+        mbiNumMul( &d, &b, &a );
+        mbiNumSub( &d, &d, &c );
+        mbiNumSet( &c, a.length, a.digits, a.negative );
+        mbiNumAdd( &c, &c, &c );
+        mbiNumMul( &c, &c, &a );
+        mbiNumMul( &a, &a, &a );
+        mbiNumAdd( &a, &a, &a );
+        if( d.length != 0 || mbiNumCompare( &a, &c ) != 0 ){ printf( "-- Error in handle identities\n" ); return 1; }
+        
+        /* 0 + b = b, b - 0 = b, 0 - b = -b with a fresh zero handle */
+        bigintnum z;
+        mbiNumInit( &z, NULL );
+        mbiNumAdd( &d, &z, &b );
+        bool ok = mbiNumCompare( &d, &b ) == 0;
+        mbiNumSub( &d, &b, &z );
+        ok = ok && mbiNumCompare( &d, &b ) == 0;
+        mbiNumSub( &d, &z, &b );
+        d.negative = !d.negative;
+        ok = ok && mbiNumCompare( &d, &b ) == 0;
+        mbiNumAdd( &d, &z, &z );
+        ok = ok && d.length == 0;
+        if( !ok ){ printf( "-- Error in handle arithmetic with zero\n" ); return 1; }
+        mbiNumFree( &z );
+        
+        mbiNumFree( &a );
+        mbiNumFree( &b );
+        mbiNumFree( &c );
+        mbiNumFree( &d );
+        free( P );
+        
+      }
+      
+    }
+    
+
+    /*******************************/
+    /* Testing of functionality    */
+    /* Asynchronous multiplication */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing asynchronous multiplication...\n" );
+      
+      const unsigned int jobs = 200;
+      bigintqueue queue;
+      bigintjob* J = malloc( sizeof(bigintjob) * jobs );
+      bigintlength* L = malloc( sizeof(bigintlength) * 2 * jobs );
+      bigint** A = malloc( sizeof(bigint*) * jobs );
+      bigint** B = malloc( sizeof(bigint*) * jobs );
+      bigint** R = malloc( sizeof(bigint*) * jobs );
+      bigint* check = malloc( sizeof(bigint) * 2 * 2000 );
+      
+      if( !mbiQueueInit( &queue, 3, 16 ) ){ printf( "-- Error starting the queue\n" ); return 1; }
+      
+      for( unsigned int i = 0; i < jobs; i++ )
+      {
+        /* mostly small jobs, which get batched, and a few large ones */
+        L[2*i]   = ( i % 17 == 0 ) ? 1000 + i : 1 + mbiRandomBelow( &rng, 40 );
+        L[2*i+1] = ( i % 17 == 0 ) ? 900 : 1 + mbiRandomBelow( &rng, 40 );
+        A[i] = malloc( sizeof(bigint) * L[2*i] );
+        B[i] = malloc( sizeof(bigint) * L[2*i+1] );
+        R[i] = malloc( sizeof(bigint) * ( L[2*i] + L[2*i+1] ) );
+        mbiRandomFill( &rng, L[2*i], A[i] );
+        mbiRandomFill( &rng, L[2*i+1], B[i] );
+        mbiJobInit( &J[i], R[i], L[2*i], A[i], L[2*i+1], B[i], NULL, NULL );
+        if( i % 2 == 0 || !mbiTrySubmit( &queue, &J[i] ) )
+          mbiSubmit( &queue, &J[i] );
+      }
+      
+      mbiJobWait( &queue, &J[jobs-1] );
+      mbiDrain( &queue );
+      
+      for( unsigned int i = 0; i < jobs; i++ )
+      {
+        mbiMultiplyUnbalanced( check, L[2*i], A[i], L[2*i+1], B[i] );
+        if( !mbiJobDone( &J[i] ) || mbiCompare( L[2*i] + L[2*i+1], check, R[i] ) != 0 )
+        {
+          printf( "-- Error in asynchronous job %u\n", i );
+          return 1;
+        }
+        free( A[i] );
+        free( B[i] );
+        free( R[i] );
+      }
+      
+      mbiQueueShutdown( &queue );
+      free( J ); free( L ); free( A ); free( B ); free( R ); free( check );
+      
+      /* Several producers on a small queue, so that workers often find the
+         next slot claimed by one producer but not yet written */
+      const unsigned int producers = 8, count = 20000;
+      pthread_t threads[8];
+      asyncproducer P[8];
+      
+      if( !mbiQueueInit( &queue, 4, 8 ) ){ printf( "-- Error starting the queue\n" ); return 1; }
+      
+      for( unsigned int t = 0; t < producers; t++ )
+      {
+        P[t].queue    = &queue;
+        P[t].count    = count;
+        P[t].jobs     = malloc( sizeof(bigintjob) * count );
+        P[t].factors  = malloc( sizeof(bigint) * 2 * count );
+        P[t].products = malloc( sizeof(bigint) * 2 * count );
+        mbiRandomFill( &rng, 2 * count, P[t].factors );
+      }
+      for( unsigned int t = 0; t < producers; t++ )
+        if( pthread_create( &threads[t], NULL, asyncProducerRun, &P[t] ) != 0 ){ printf( "-- Error starting a producer\n" ); return 1; }
+      for( unsigned int t = 0; t < producers; t++ )
+        pthread_join( threads[t], NULL );
+      
+      mbiDrain( &queue );
+      
+      for( unsigned int t = 0; t < producers; t++ )
+      {
+        for( unsigned int i = 0; i < count; i++ )
+        {
+          bigint hi, lo = mbiMulDigits( P[t].factors[2*i], P[t].factors[2*i+1], &hi );
+          if( !mbiJobDone( &P[t].jobs[i] ) || P[t].products[2*i] != lo || P[t].products[2*i+1] != hi )
+          {
+            printf( "-- Error in asynchronous job %u of producer %u\n", i, t );
+            return 1;
+          }
+        }
+        free( P[t].jobs ); free( P[t].factors ); free( P[t].products );
+      }
+      
+      mbiQueueShutdown( &queue );
+      
+    }
+    
+
+    /*******************************/
+    /* Testing of functionality    */
+    /* Product trees               */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing product trees...\n" );
+      
+      /* Factorial of 3000 from single digits, and a mix of lengths with some padding */
+      const bigintlength count = 3000;
+      bigintlength* L = malloc( sizeof(bigintlength) * count );
+      bigint* O = malloc( sizeof(bigint) * count * 41 );
+      bigintlength s = 0;
+      
+      for( unsigned int t = 0; t < 2; t++ )
+      {
+        
+        if( t == 0 ){
+          for( bigintlength i = 0; i < count; i++ ) O[i] = i + 1;
+          s = count;
+        }else{
+          s = 0;
+          for( bigintlength i = 0; i < count; i++ )
+          {
+            L[i] = ( i % 5 == 0 ) ? 1 + mbiRandomBelow( &rng, 40 ) : 1;
+            mbiRandomFill( &rng, L[i], O + s );
+            O[s + L[i] - 1] |= 1;
+            if( i % 7 == 0 && L[i] > 1 ) O[s + L[i] - 1] = 0;
+            s += L[i];
+          }
+        }
+        
+        const bigintlength* lengths = t == 0 ? NULL : L;
+        bigint* R1 = calloc( s + 1, sizeof(bigint) );
+        bigint* R2 = malloc( sizeof(bigint) * s );
+        bigint* R3 = malloc( sizeof(bigint) * s );
+        bigint* T  = malloc( sizeof(bigint) * ( s + 1 ) );
+        
+        /* one after another, starting with 1 */
+        bigintlength r = 1, in = 0;
+        R1[0] = 1;
+        for( bigintlength i = 0; i < count; i++ )
+        {
+          bigintlength n = lengths ? lengths[i] : 1;
+          mbiMultiplyUnbalanced( T, r, R1, n, O + in );
+          mbiCopy( r + n, R1, T );
+          r += n;
+          in += n;
+        }
+        
+        bigintlength l2 = mbiProductTree( R2, count, O, lengths );
+        
+        bigintqueue queue;
+        if( !mbiQueueInit( &queue, 2, 64 ) ){ printf( "-- Error starting the queue\n" ); return 1; }
+        bigintlength l3 = mbiProductTreeParallel( &queue, R3, count, O, lengths );
+        mbiQueueShutdown( &queue );
+        
+        bigintlength l1; unsigned long bits;
+        mbiGetNumericalLength( s, R1, &l1, &bits );
+        
+        if( l1 != l2 || l1 != l3 || mbiCompare( s, R1, R2 ) != 0 || mbiCompare( s, R1, R3 ) != 0 )
+        {
+          printf( "-- Error in product tree %u\n", t );
+          return 1;
+        }
+        
+        free( R1 ); free( R2 ); free( R3 ); free( T );
+      }
+      
+      /* A zero operand */
+      O[17] = 0;
+      bigint Z[3000];
+      if( mbiProductTree( Z, count, O, NULL ) != 0 || !mbiIsZero( count, Z ) ){ printf( "-- Error in product tree with zero\n" ); return 1; }
+      
+      free( L );
+      free( O );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Squares and powers          */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing squares and powers...\n" );
+      
+      bigint* A = malloc( sizeof(bigint) * 3000 );
+      bigint* P = malloc( sizeof(bigint) * 6000 );
+      bigint* Q = malloc( sizeof(bigint) * 6000 );
+      
+      for( bigintlength l = 1; l < 3000; l += ( l < 200 ? 1 : 331 ) )
+      {
+        mbiRandomFill( &rng, l, A );
+        if( l % 3 == 0 ) mbiSetDigits( l, A, DIGIT_MAX );
+        mbiSquareN( l, P, A );
+        mbiMultiplyN( l, Q, A, A );
+        if( mbiCompare( 2*l, P, Q ) != 0 ){ printf( "-- Error in square of %lu digits\n", l ); return 1; }
+      }
+      
+      /* Powers compared with repeated multiplication */
+      const bigintlength lengths[]   = { 1, 1, 1, 1, 2, 3, 5, 1, 4 };
+      const unsigned long exponents[] = { 0, 1, 1000, 77, 100, 513, 37, 4001, 5 };
+      
+      for( unsigned int t = 0; t < sizeof(lengths)/sizeof(lengths[0]); t++ )
+      {
+        bigintlength n = lengths[t];
+        mbiRandomFill( &rng, n, A );
+        if( t == 2 ) A[0] = 10;
+        if( t == 7 ) A[0] = 1UL << 37;
+        if( t == 8 ) A[3] = 0;
+        
+        bigintlength size = mbiPowSize( n, A, exponents[t] );
+        bigint* R = malloc( sizeof(bigint) * size );
+        bigint* S = calloc( size + n, sizeof(bigint) );
+        bigint* T = malloc( sizeof(bigint) * ( size + n ) );
+        
+        bigintlength l = mbiPow( R, n, A, exponents[t] );
+        
+        bigintlength ls = 1;
+        S[0] = 1;
+        for( unsigned long e = 0; e < exponents[t]; e++ )
+        {
+          mbiMultiplyUnbalanced( T, ls, S, n, A );
+          mbiCopy( ls + n, S, T );
+          ls = ls + n;
+          while( ls > 1 && S[ls-1] == 0 ) ls--;
+        }
+        
+        if( ls > size || l != ls || mbiCompare( size, R, S ) != 0 ){ printf( "-- Error in power %u\n", t ); return 1; }
+        
+        free( R ); free( S ); free( T );
+      }
+      
+      /* 0^e */
+      A[0] = 0;
+      if( mbiPow( P, 1, A, 10 ) != 0 || P[0] != 0 ){ printf( "-- Error in power of zero\n" ); return 1; }
+      
+      free( A ); free( P ); free( Q );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Roots                       */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing roots...\n" );
+      
+      const bigintlength lengths[] = { 1, 2, 3, 17, 100, 700, 2500 };
+      const unsigned long roots[]  = { 2, 3, 5, 64, 1000 };
+      bigint* A = malloc( sizeof(bigint) * 2500 );
+      bigint* S = malloc( sizeof(bigint) * 2500 );
+      bigint* R = malloc( sizeof(bigint) * 2500 );
+      bigintnum a, s, t;
+      bigint one = 1;
+      mbiNumInit( &a, NULL );
+      mbiNumInit( &s, NULL );
+      mbiNumInit( &t, NULL );
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( unsigned int j = 0; j < sizeof(roots)/sizeof(roots[0]); j++ )
+      for( unsigned int v = 0; v < 3; v++ )
+      {
+        bigintlength n = lengths[i];
+        unsigned long k = roots[j];
+        mbiRandomFill( &rng, n, A );
+        A[n-1] |= 1;
+        if( v == 1 ) mbiSetDigits( n, A, DIGIT_MAX );
+        
+        /* a perfect power minus one */
+        if( v == 2 ){
+          bigintlength l = ( n + k - 1 ) / k;
+          mbiRandomFill( &rng, l, S );
+          S[l-1] |= 1;
+          mbiNumSet( &s, l, S, false );
+          mbiNumPow( &t, &s, k );
+          if( t.length > n ) continue;
+          mbiSetZero( n, A );
+          mbiCopy( t.length, A, t.digits );
+          bool carry = false;
+          mbiDec( n, A, &carry );
+        }
+        
+        bigintlength l = mbiRootRem( S, R, n, A, k );
+        
+        /* s^k + r = a and (s+1)^k > a */
+        mbiNumSet( &a, n, A, false );
+        mbiNumSet( &s, l, S, false );
+        mbiNumPow( &t, &s, k );
+        mbiNumSet( &s, n, R, false );
+        mbiNumAdd( &t, &t, &s );
+        bool ok = mbiNumCompare( &t, &a ) == 0;
+        
+        mbiNumSet( &s, l, S, false );
+        mbiNumSet( &t, 1, &one, false );
+        mbiNumAdd( &s, &s, &t );
+        mbiNumPow( &t, &s, k );
+        ok = ok && mbiNumCompare( &t, &a ) > 0;
+        
+        if( !ok ){
+          printf( "-- Error in root %lu of %lu digits\n", k, n );
+          return 1;
+        }
+      }
+      
+      /* the roots of zero, also of a fresh handle */
+      bigintnum zero, r;
+      mbiNumInit( &zero, NULL );
+      mbiNumInit( &r, NULL );
+      mbiSetZero( 4, A );
+      mbiSetDigits( 4, S, DIGIT_MAX );
+      mbiSetDigits( 4, R, DIGIT_MAX );
+      bool ok = mbiSqrtRem( S, R, 4, A ) == 0 && mbiIsZero( 2, S ) && mbiIsZero( 4, R );
+      ok = ok && mbiRootRem( S, R, 4, A, 3 ) == 0 && mbiIsZero( 2, S ) && mbiIsZero( 4, R );
+      mbiNumSet( &s, 1, &one, false );
+      mbiNumRootRem( &s, &r, &zero, 5 );
+      ok = ok && s.length == 0 && r.length == 0;
+      if( !ok ){
+        printf( "-- Error in the roots of zero\n" );
+        return 1;
+      }
+      mbiNumFree( &zero );
+      mbiNumFree( &r );
+      
+      mbiNumFree( &a );
+      mbiNumFree( &s );
+      mbiNumFree( &t );
+      free( A ); free( S ); free( R );
+      
+    }
+    
+    {
+      printf( "Testing division by single digits...\n" );
+      
+      const bigintlength lengths[] = { 1, 2, 7, 100, 1000 };
+      bigint divisors[] = { 1, 2, 3, 10, 0xffffffffULL, (bigint)1 << 63, DIGIT_MAX, 0, 0, 0 };
+      const unsigned int count = sizeof(divisors)/sizeof(divisors[0]);
+      bigintreciprocal reciprocals[sizeof(divisors)/sizeof(divisors[0])];
+      bigint rems[sizeof(divisors)/sizeof(divisors[0])];
+      bigint* A = malloc( sizeof(bigint) * 1000 );
+      bigint* Q = malloc( sizeof(bigint) * 1000 );
+      bigint* P = malloc( sizeof(bigint) * 1000 );
+      
+      divisors[count-3] = mbiRandomDigit( &rng ) | 1;
+      divisors[count-2] = mbiRandomDigit( &rng ) >> 30;
+      divisors[count-1] = ( mbiRandomDigit( &rng ) >> 1 ) | ( (bigint)1 << 62 );
+      for( unsigned int j = 0; j < count; j++ ) mbiReciprocalInit( &reciprocals[j], divisors[j] );
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( int pattern = 0; pattern < MBI_PATTERNS; pattern++ )
+      {
+        bigintlength n = lengths[i];
+        mbiRandomPattern( &rng, n, A, pattern );
+        mbiRemLimbs( n, A, count, reciprocals, rems );
+        
+        for( unsigned int j = 0; j < count; j++ )
+        {
+          /* q d + r = a with r < d, digit by digit against DivDigits */
+          bigint d = divisors[j], r = mbiDivRemLimb( n, Q, A, d ), s = 0;
+          bool ok = r < d && r == rems[j];
+          for( bigintlength k = n; k > 0; k-- )
+            ok = ok && mbiDivDigits( s, A[k-1], d, &s ) == Q[k-1];
+          bigint c = mbiMulLimb( n, P, Q, d );
+          ok = ok && s == r && c == 0 && mbiAddDigit( n, P, r ) == false && mbiCompare( n, P, A ) == 0;
+          if( !ok ){
+            printf( "-- Error in division of %lu digits by %016llx, pattern %d\n", (unsigned long)n, (unsigned long long)d, pattern );
+            return 1;
+          }
+        }
+      }
+      
+      free( A ); free( Q ); free( P );
+    }
+    
+    {
+      printf( "Testing division and greatest common divisors...\n" );
+      
+      const bigintlength lengths[][3] = { {1,1,1}, {2,1,1}, {5,3,2}, {40,40,1}, {300,120,7}, {1500,1400,300} };
+      bigint* A = malloc( sizeof(bigint) * 3000 );
+      bigint* B = malloc( sizeof(bigint) * 3000 );
+      bigint* C = malloc( sizeof(bigint) * 3000 );
+      bigint* G = malloc( sizeof(bigint) * 3000 );
+      bigint* S = malloc( sizeof(bigint) * 3000 );
+      bigint* T = malloc( sizeof(bigint) * 3000 );
+      bigintnum a, b, g, s, t, u;
+      mbiNumInit( &a, NULL );
+      mbiNumInit( &b, NULL );
+      mbiNumInit( &g, NULL );
+      mbiNumInit( &s, NULL );
+      mbiNumInit( &t, NULL );
+      mbiNumInit( &u, NULL );
+      
+      for( unsigned int i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++ )
+      for( unsigned int v = 0; v < 3; v++ )
+      {
+        bigintlength n1 = lengths[i][0], n2 = lengths[i][1], nc = lengths[i][2];
+        
+        /* a = x c and b = y c with a common factor c, or consecutive Fibonacci numbers */
+        mbiRandomFill( &rng, n1, A );
+        mbiRandomFill( &rng, n2, B );
+        mbiRandomFill( &rng, nc, C );
+        A[n1-1] |= 1;
+        B[n2-1] |= 1;
+        C[nc-1] |= 1;
+        mbiNumSet( &a, n1, A, false );
+        mbiNumSet( &b, n2, B, false );
+        mbiNumSet( &s, nc, C, false );
+        if( v > 0 ){
+          mbiNumMul( &a, &a, &s );
+          mbiNumMul( &b, &b, &s );
+        }
+        if( v == 2 ){
+          bigint one = 1;
+          mbiNumSet( &a, 1, &one, false );
+          mbiNumSet( &b, 1, &one, false );
+          while( b.length < n1 )
+          {
+            mbiNumAdd( &a, &a, &b );
+            mbiNumSwap( &a, &b );
+          }
+        }
+        
+        /* q b + r = a with r < b */
+        mbiNumDivRem( &s, &t, &a, &b );
+        mbiNumMul( &u, &s, &b );
+        mbiNumAdd( &u, &u, &t );
+        if( mbiNumCompare( &u, &a ) != 0 || mbiNumCompare( &t, &b ) >= 0 ){
+          printf( "-- Error in division of %lu by %lu digits\n", a.length, b.length );
+          return 1;
+        }
+        
+        /* g divides a and b, and g = s a + t b */
+        bigintlength m1 = a.length, m2 = b.length;
+        mbiCopy( m1, A, a.digits );
+        mbiCopy( m2, B, b.digits );
+        bool sneg, tneg;
+        bigintlength l = mbiGcdExt( G, S, &sneg, T, &tneg, m1, A, m2, B );
+        mbiNumSet( &g, l, G, false );
+        mbiNumSet( &s, m2, S, sneg );
+        mbiNumSet( &t, m1, T, tneg );
+        mbiNumNormalize( &s );
+        mbiNumNormalize( &t );
+        mbiNumMul( &s, &s, &a );
+        mbiNumMul( &t, &t, &b );
+        mbiNumAdd( &s, &s, &t );
+        bool ok = mbiNumCompare( &s, &g ) == 0;
+        mbiNumDivRem( NULL, &s, &a, &g );
+        mbiNumDivRem( NULL, &t, &b, &g );
+        ok = ok && s.length == 0 && t.length == 0;
+        ok = ok && mbiGcd( C, m1, A, m2, B ) == l && mbiCompare( l, C, G ) == 0;
+        
+        if( !ok ){
+          printf( "-- Error in gcd of %lu and %lu digits\n", m1, m2 );
+          return 1;
+        }
+      }
+      
+      mbiNumFree( &a );
+      mbiNumFree( &b );
+      mbiNumFree( &g );
+      mbiNumFree( &s );
+      mbiNumFree( &t );
+      mbiNumFree( &u );
+      free( A ); free( B ); free( C ); free( G ); free( S ); free( T );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Special moduli              */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing special moduli...\n" );
+      
+      const struct { unsigned long p; bigint c; } moduli[] = {
+        { 5, 1 }, { 5, 4 }, { 61, 1 }, { 61, 1UL << 30 }, { 64, 59 }, { 64, 1UL << 32 }, { 89, 1 }, { 128, 159 }, { 255, 19 }, { 1279, 1 }, { 1300, 0xfffffffffffULL }, { 1300, DIGIT_MAX }, { 4096, 3 }
+      };
+      bigint* X = malloc( sizeof(bigint) * 200 );
+      bigint* Y = malloc( sizeof(bigint) * 200 );
+      bigint* M = malloc( sizeof(bigint) * 100 );
+      bigint* Q = malloc( sizeof(bigint) * 200 );
+      bigint* R = malloc( sizeof(bigint) * 100 );
+      bigint* scratch = malloc( sizeof(bigint) * 200 );
+      
+      for( unsigned int i = 0; i < sizeof(moduli)/sizeof(moduli[0]); i++ )
+      for( int pattern = 0; pattern < MBI_PATTERNS; pattern++ )
+      {
+        unsigned long p = moduli[i].p;
+        bigint c = moduli[i].c;
+        bigintlength n = mbiSpecialLength( p );
+        
+        /* M = 2^p - c, and a number of up to 2n digits */
+        mbiSpecialSetMinus( p, M, c - 1 );
+        mbiRandomPattern( &rng, 2*n, X, pattern );
+        X[2*n] = 0;
+        memcpy( Y, X, sizeof(bigint) * ( 2*n + 1 ) );
+        
+        mbiDivRem( Q, R, 2*n, Y, n, M );
+        mbiReduceSpecial( p, c, 2*n + 1, X, scratch );
+        if( mbiCompare( n, X, R ) != 0 || !mbiIsZero( n + 1, X + n ) ){
+          printf( "-- Error in the reduction modulo 2^%lu - %lu, pattern %d\n", p, (unsigned long)c, pattern );
+          return 1;
+        }
+      }
+      
+      /* Mersenne primes and composites */
+      const unsigned long exponents[] = { 3, 7, 11, 31, 61, 67, 89, 523, 607, 1277, 1279, 2203 };
+      for( unsigned int i = 0; i < sizeof(exponents)/sizeof(exponents[0]); i++ )
+      {
+        unsigned long p = exponents[i];
+        bool prime = p != 11 && p != 67 && p != 523 && p != 1277;
+        if( mbiLucasLehmer( p ) != prime || mbiFermatSpecial( p, 1, 3 ) != prime ){
+          printf( "-- Error in the tests of 2^%lu - 1\n", p );
+          return 1;
+        }
+      }
+      
+      /* 2^255 - 19 and 2^130 - 5 are prime, 2^255 - 21 is not */
+      if( !mbiFermatSpecial( 255, 19, 2 ) || !mbiFermatSpecial( 130, 5, 3 ) || mbiFermatSpecial( 255, 21, 2 ) ){
+        printf( "-- Error in the Fermat test of pseudo-Mersenne numbers\n" );
+        return 1;
+      }
+      
+      free( X ); free( Y ); free( M ); free( Q ); free( R ); free( scratch );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Floating point numbers      */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing floating point numbers...\n" );
+      
+      const bigintlength precs[] = { 1, 2, 5, 40, 150, 700 };
+      bigint* A = malloc( sizeof(bigint) * 710 );
+      bigint* B = malloc( sizeof(bigint) * 710 );
+      
+      for( unsigned int i = 0; i < sizeof(precs)/sizeof(precs[0]); i++ )
+      for( int pattern = 0; pattern < MBI_PATTERNS; pattern++ )
+      {
+        bigintlength P = precs[i], n = P + 5;
+        bigintnum x;
+        bigintfloat a, b, q, e, one;
+        mbiNumInit( &x, NULL );
+        mbiFloatInit( &a, n, NULL );
+        mbiFloatInit( &b, n, NULL );
+        mbiFloatInit( &q, P, NULL );
+        mbiFloatInit( &e, 3*n, NULL );
+        mbiFloatInit( &one, 1, NULL );
+        mbiFloatSetDigit( &one, 1, false );
+        
+        mbiRandomPattern( &rng, n, A, pattern );
+        mbiRandomFill( &rng, n, B );
+        A[n-1] |= 1;
+        B[n-1] |= 1;
+        mbiNumSet( &x, n, A, pattern % 2 == 1 );
+        mbiFloatSetNum( &a, &x );
+        mbiFloatMulPow2( &a, &a, -(long)( n * DIGIT_BITS ) + pattern );
+        mbiNumSet( &x, n, B, false );
+        mbiFloatSetNum( &b, &x );
+        mbiFloatMulPow2( &b, &b, (long)( 3 * DIGIT_BITS ) - 7 );
+        
+        /* the exact residuals are small relative to their terms */
+        mbiFloatInv( &q, &a );
+        mbiFloatMul( &e, &a, &q );
+        mbiFloatSub( &e, &e, &one );
+        bool ok = e.mant.length == 0 || e.expo + (long)e.mant.length <= 1 - (long)P;
+        
+        mbiFloatDiv( &q, &b, &a );
+        mbiFloatMul( &e, &a, &q );
+        mbiFloatSub( &e, &b, &e );
+        ok = ok && ( e.mant.length == 0 || e.expo + (long)e.mant.length <= b.expo + (long)b.mant.length + 1 - (long)P );
+        
+        mbiFloatSqrt( &q, &b );
+        mbiFloatMul( &e, &q, &q );
+        mbiFloatSub( &e, &b, &e );
+        ok = ok && ( e.mant.length == 0 || e.expo + (long)e.mant.length <= b.expo + (long)b.mant.length + 1 - (long)P );
+        
+        /* a + b - b is a up to the precision of the sum */
+        mbiFloatSetPrecision( &q, n + 4 );
+        mbiFloatAdd( &q, &a, &b );
+        mbiFloatSub( &q, &q, &b );
+        mbiFloatSub( &e, &q, &a );
+        ok = ok && ( e.mant.length == 0 || e.expo + (long)e.mant.length <= b.expo + (long)b.mant.length - (long)n - 3 );
+        
+        if( !ok ){
+          printf( "-- Error in floating point numbers of %lu digits\n", P );
+          return 1;
+        }
+        
+        mbiNumFree( &x );
+        mbiFloatFree( &a );
+        mbiFloatFree( &b );
+        mbiFloatFree( &q );
+        mbiFloatFree( &e );
+        mbiFloatFree( &one );
+      }
+      
+      free( A ); free( B );
+      
+    }
+    
+    
+    /*******************************/
+    /* Testing of functionality    */
+    /* Residue number systems      */
+    /*******************************/
+    
+    {
+      
+      printf( "Testing residue number systems...\n" );
+      
+      const unsigned int rows = 5, cols = 6, digits = 300;
+      bigintrns rns;
+      bigintqueue queue;
+      bigintnum x, y, sum;
+      mbiNumInit( &x, NULL );
+      mbiNumInit( &y, NULL );
+      mbiNumInit( &sum, NULL );
+      bigint* z = malloc( sizeof(bigint) * digits );
+      
+      /* the sum has at most rows * 2^(cols*digits*DIGIT_BITS) */
+      mbiRnsInit( &rns, cols*digits*DIGIT_BITS + 3 );
+      bigint** factors = malloc( sizeof(bigint*) * rows*cols );
+      bigint* r = malloc( sizeof(bigint) * rns.count );
+      bigint* s = malloc( sizeof(bigint) * rns.count );
+      
+      for( unsigned int i = 0; i < rows; i++ )
+      {
+        for( unsigned int k = 0; k < cols; k++ )
+        {
+          bigintlength n = 1 + mbiRandomBelow( &rng, digits );
+          mbiRandomPattern( &rng, n, z, (int)( ( i + k ) % MBI_PATTERNS ) );
+          mbiNumSet( &x, n, z, mbiRandomBelow( &rng, 2 ) == 1 );
+          factors[i*cols+k] = malloc( sizeof(bigint) * rns.count );
+          mbiRnsFromNum( &rns, factors[i*cols+k], &x );
+          if( k == 0 ) mbiNumSet( &y, x.length, x.digits, x.negative );
+          else mbiNumMul( &y, &y, &x );
+        }
+        mbiNumAdd( &sum, &sum, &y );
+      }
+      
+      /* the whole chain by the workers */
+      rnschain chain = { &rns, rows, cols, factors, s };
+      if( !mbiQueueInit( &queue, 3, 16 ) ){ printf( "-- Error starting the queue\n" ); return 1; }
+      mbiRnsParallel( &queue, rns.count, rnsChainRun, &chain );
+      mbiQueueShutdown( &queue );
+      mbiRnsToNum( &rns, &x, s, true );
+      if( mbiNumCompare( &x, &sum ) != 0 ){
+        printf( "-- Error in the parallel chain of a residue number system\n" );
+        return 1;
+      }
+      
+      /* the same by vectors, and minus the sum gives zero */
+      mbiRnsSetDigit( &rns, s, 0, false );
+      for( unsigned int i = 0; i < rows; i++ )
+      {
+        mbiRnsSetDigit( &rns, r, 1, false );
+        for( unsigned int k = 0; k < cols; k++ )
+          mbiRnsMul( &rns, r, r, factors[i*cols+k] );
+        mbiRnsAdd( &rns, s, s, r );
+      }
+      mbiRnsFromNum( &rns, r, &sum );
+      mbiRnsSub( &rns, s, s, r );
+      mbiRnsToNum( &rns, &x, s, true );
+      if( x.length != 0 ){
+        printf( "-- Error in the operations of a residue number system\n" );
+        return 1;
+      }
+      
+      /* -7 is M - 7 without sign */
+      mbiRnsSetDigit( &rns, r, 7, true );
+      mbiRnsToNum( &rns, &x, r, false );
+      mbiNumSub( &x, &rns.products[1], &x );
+      if( x.length != 1 || x.digits[0] != 7 ){
+        printf( "-- Error in the conversion of a residue number system\n" );
+        return 1;
+      }
+      
+      for( unsigned int i = 0; i < rows*cols; i++ ) free( factors[i] );
+      free( factors ); free( r ); free( s ); free( z );
+      mbiNumFree( &x );
+      mbiNumFree( &y );
+      mbiNumFree( &sum );
+      mbiRnsFree( &rns );
+      
+    }
+    
+    
+    /***************/
+    /* Performance */
+    /***************/
+    
+    {
+      
+      printf( "Performance Test....\n" );
+    
+      long int t1, t2;
+    
+      t1 = clock();
+    
+      const bigintexpo k = 10;
+      const bigintlength l = 1 << k; /* Number of digits */
+      
+      long int v = 0, vmax = 100;
+      
+      /* printf( "Multiply %ld-times two numbers of length %ld\n", vmax, l ); */
+      printf( "-- %ld multiplication of two numbers of %ld digits each in base 2^32\n", vmax, l );
+      printf( "-- approx. %lld decimal digits\n", (long long) 9 * l );
+
+      /*
+      * We can use several samples:
+      * Iterate one specific multiplication
+      * A specific subset of mulitplications
+      * random numbers
+      * ...
+      */
+      
+      for( v = 0; v < vmax; v++ ){
+    
+        bigint P[l], Q[l];
+        bigint R[2*l];
         
-        mbiShuffle( l, P, 0 );
-        mbiShuffle( l, Q, 0 );
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
         
         mbiMultiply( k, R, P, Q );
         
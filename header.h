@@ -47,14 +47,35 @@
   /* Includes                                  */
   /*********************************************/
 
+  /* mmap flags and syscall are extensions to C99 */
+  #if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+  #define _DEFAULT_SOURCE
+  #endif
+
   #include <assert.h>
   #include <limits.h>
   #include <math.h>
+  #include <stdint.h>
   #include <stdio.h>
   #include <stdlib.h>
   #include <string.h>
   #include <time.h> 
   
+  #if defined(__linux__)
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #endif
+  
+  /* Large blocks are mapped directly, see Memory */
+  #if defined(MAP_ANONYMOUS) && defined(MADV_HUGEPAGE) && !defined(MBI_NO_MMAP)
+  #define MBI_ALLOC_MMAP
+  #endif
+  
+  #if defined(__AVX2__) || defined(__AVX512F__)
+  #include <immintrin.h>
+  #endif
+  
   
   
   
@@ -75,6 +96,7 @@
   #define DIGIT_MAX  ((bigint)ULONG_MAX)
   #define DIGTI_MIN  ((bigint)0)
   #define DIGIT_ZERO ((bigint)0)
+  #define DIGIT_BITS (8*sizeof(bigint))
 
   
   
@@ -248,39 +270,13 @@
     if( setzero ) mbiSetZero( r, z + n - r );
   }
   
-  /*
-  * Performs right shift, bit-wise precision
-  * Remarks: NONE
-  */
-  void mbiBitRightShift( bigintlength n, bigint* z, unsigned long r, bool setzero )
-  {
-    if( r > 8*sizeof(bigint) ){
-      mbiRightShift( n, z, r / (8*sizeof(bigint)), setzero );
-      r %= 8*sizeof(bigint);
-    }
-    assert( r <= 8*sizeof( bigint ) );
-    bigint maske = 0;
-    maske = ~maske;
-    maske = maske << r;
-    maske = ~maske;
-    for( bigintlength i = 0; i < n ; i++ )
-    {
-      z[i] = z[i] >> r;
-      if( i+1 < n ){
-        bigint mem = maske & z[i+1];
-        mem = mem << (sizeof(bigint)*8-r);
-        z[i] |= mem;
-      }
-    }
-    setzero = !setzero;
-  }
-  
   /*
   * Performs left shift
   * Remarks: NONE
   */
   void mbiLeftShift( bigintlength n, bigint* z, bigintlength r )
   {
+    assert( r <= n );
     for( bigintlength i = n-r; i > 0; i-- )
     {
       z[r+i-1] = z[i-1];
@@ -288,41 +284,11 @@
     mbiSetZero( r, z );
   }
   
-  /*
-  * Performs left shift, bitwise-precision
-  * Remarks: NONE
-  */
-  void mbiBitLeftShift( bigintlength n, bigint* z, unsigned long r )
-  {
-    
-    if( r > 8*sizeof(bigint) ){
-      mbiLeftShift( n, z, r / (8*sizeof(bigint)) );
-      r %= 8*sizeof(bigint);
-    }
-    
-    assert( r <= 8 * sizeof( bigint ) );
-    bigint maske = 0;
-    maske = ~maske;
-    maske >>= r;
-    maske = ~maske;
-    for( bigintlength i = n; i > 0; i-- )
-    {
-      z[i-1] <<= r;
-      if( i-1 > 0 ){
-        bigint mem = maske & z[i-2];
-        mem >>= (sizeof(bigint)*8-r);
-        z[i-1] |= mem;
-      }
-    }
-  }
-  
-  
-  
-  
-
   /*
   * Fills a Big Int with random values
-  * Remarks: Uses standard 'rand' function
+  * Remarks: Uses standard 'rand' function, which is global, not thread
+    safe and fills only 31 bits of a digit. Kept for old callers; new code
+    takes mbiRandomFill.
   */
   void mbiShuffle( bigintlength n, bigint* z, bigint modulo )
   {
@@ -344,570 +310,6280 @@
     for( bigintlength i = 0; i < n; i++ )
       z[i] = digit;
   }
-
   
   
-
-  /**************************/
-  /* Elementary Arithmetics */
-  /**************************/
-
+  
+  
+  /*********************************************/
+  /* Random numbers                            */
+  /*********************************************/
+  
   /*
-  * Adds a big int to another big int, taking into account the carry.
-  * Remark: dest and add point to Big Int of length n. add is added onto dest.
-    carry points to a boolean value which (i) gives input, whether 1 shall
-    be added to the sum or not (ii) whether there has been an overflow has
-    taken place during execution (1) or not (0). It's a simulation of a
-    carry-save-adder.
+  * Test data comes from xoshiro256++ generators with explicit state, so
+  * every thread can own one and runs are reproducible from the seed. The
+  * state holds MBI_RANDOM_LANES generators whose outputs are interleaved;
+  * the lanes are independent, so the compiler turns the fill loop into
+  * vector instructions. The lanes start 2^128 outputs apart, and Jump
+  * moves a copy to a new set of lanes for the next thread.
   */
-  bool mbiAdd( bigintlength n, bigint* dest, const bigint* add, bool* carry )
-  {
-    
-    bigintlength i;
-    for( i = 0; i < n; i++ )
-    {
-      dest[i] += add[i];
-      if( *carry ) dest[i]++;
-      if( ( !(*carry) && add[i] > dest[i] ) || ( *carry && add[i] >= dest[i] ) )
-        *carry = true;
-      else
-        *carry = false;
-    }
-    
-    return *carry;
-  }
   
+  #ifndef MBI_RANDOM_LANES
+  #define MBI_RANDOM_LANES 4
+  #endif
+  
+  typedef struct {
+    uint64_t s[4][MBI_RANDOM_LANES];
+  } bigintrandom;
   
+  /* Patterns of RandomPattern */
+  #define MBI_PATTERN_RANDOM      0 /* uniform digits */
+  #define MBI_PATTERN_MAX         1 /* all digits DIGIT_MAX */
+  #define MBI_PATTERN_BIT         2 /* a single set bit */
+  #define MBI_PATTERN_ALTERNATING 3 /* digits DIGIT_MAX and 0 in turn */
+  #define MBI_PATTERN_SPARSE      4 /* about every 16th digit random, the rest 0 */
+  #define MBI_PATTERN_NEAR_POWER  5 /* 2^(n DIGIT_BITS) - d or 2^(n DIGIT_BITS - 1) + d */
+  #define MBI_PATTERNS            6
   
   /*
-  * Adds to big ints, saves the result and takes into account the carry.
-  * Remark: Works like Add, but with two summands and an argument for a
-    pointer the sum is written to. dest and add1 are allowed to point to
-    the same block of memory
+  * Takes one step of the generator of a lane
+  * Remark: Returns the output of xoshiro256++.
   */
-  bool mbiCopyAdd( bigintlength n, bigint* dest, const bigint* add1, const bigint* add2, bool* carry )
+  uint64_t mbiRandomStep( bigintrandom* r, unsigned int lane )
   {
-    assert( add2 != dest );
-    bigintlength i;
-    for( i = 0; i < n; i++ )
-    {
-      dest[i] = add1[i] + add2[i];
-      if( *carry ) dest[i]++;
-      
-      if( ( !(*carry) && add2[i] > dest[i] ) || ( *carry && add2[i] >= dest[i] ) )
-        *carry = true;
-      else
-        *carry = false;
-    }
+    uint64_t* s0 = &r->s[0][lane];
+    uint64_t* s1 = &r->s[1][lane];
+    uint64_t* s2 = &r->s[2][lane];
+    uint64_t* s3 = &r->s[3][lane];
     
-    return *carry;
+    uint64_t w = *s0 + *s3;
+    uint64_t out = ( ( w << 23 ) | ( w >> 41 ) ) + *s0;
+    uint64_t t = *s1 << 17;
+    *s2 ^= *s0;
+    *s3 ^= *s1;
+    *s1 ^= *s2;
+    *s0 ^= *s3;
+    *s2 ^= t;
+    *s3 = ( *s3 << 45 ) | ( *s3 >> 19 );
+    
+    return out;
   }
   
-  
   /*
-  * Increments a big int, taking into account the carry.
-  * Remark: dest points to a Big Int of length n. dest is incremented by 1.
-    carry points to a boolean value which (i) gives input, whether 1 shall be
-    added to the sum or not (ii) whether there has been an overflow has taken
-    place during execution (1) or not (0). It's a simulation of a
-    carry-save-adder.
+  * Advances the generator of a lane by 2^128 steps
   */
-  bool mbiInc( bigintlength n, bigint* dest, bool* carry )
+  void mbiRandomJumpLane( bigintrandom* r, unsigned int lane )
   {
+    static const uint64_t jump[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t t[4] = { 0, 0, 0, 0 };
     
-    bigintlength i;
-    
-    dest[0]++;
-    if( dest[0] == (bigint)0 ) *carry = true;
+    for( int i = 0; i < 4; i++ )
+      for( int b = 0; b < 64; b++ )
+      {
+        if( jump[i] & ( (uint64_t)1 << b ) )
+          for( int j = 0; j < 4; j++ )
+            t[j] ^= r->s[j][lane];
+        mbiRandomStep( r, lane );
+      }
     
-    for( i = 1; *carry == true && i < n; i++ )
+    for( int j = 0; j < 4; j++ )
+      r->s[j][lane] = t[j];
+  }
+  
+  /*
+  * Seeds a random generator
+  * Remark: The first lane is seeded by splitmix64, which never gives the
+    forbidden all-zero state, every further lane is one jump ahead.
+  */
+  void mbiRandomSeed( bigintrandom* r, uint64_t seed )
+  {
+    for( int j = 0; j < 4; j++ )
     {
-      dest[i]++;
-      if( dest[i] == (bigint)0 ) *carry = true;
-      else *carry = false;
+      uint64_t z = ( seed += 0x9e3779b97f4a7c15ULL );
+      z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+      z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+      r->s[j][0] = z ^ ( z >> 31 );
     }
     
-    return *carry;
-    
+    for( unsigned int k = 1; k < MBI_RANDOM_LANES; k++ )
+    {
+      for( int j = 0; j < 4; j++ )
+        r->s[j][k] = r->s[j][k-1];
+      mbiRandomJumpLane( r, k );
+    }
   }
   
+  /*
+  * Moves a random generator to the next set of lanes
+  * Remark: Every lane is advanced by MBI_RANDOM_LANES jumps, so a copy of
+    the state jumped once per thread gives streams which do not overlap.
+  */
+  void mbiRandomJump( bigintrandom* r )
+  {
+    for( unsigned int k = 0; k < MBI_RANDOM_LANES; k++ )
+      for( unsigned int i = 0; i < MBI_RANDOM_LANES; i++ )
+        mbiRandomJumpLane( r, k );
+  }
   
+  /*
+  * Returns a random digit
+  * Remark: Uses the first lane only.
+  */
+  bigint mbiRandomDigit( bigintrandom* r )
+  {
+    return (bigint)mbiRandomStep( r, 0 );
+  }
   
   /*
-  * Subtracts a big int from another big int, taking into account the carry.
-  * Remark: dest and sub point to Big Int of length n. sub is subtracted
-    from dest. carry points to a boolean value which (i) gives input,
-    whether 1 shall be drawn from the difference or not (ii) whether there
-    has been an overflow has taken place during execution (1) or not (0).
-    It's a simulation of a carry-save-adder.
+  * Returns a random number less than bound
+  * Remark: Nearly uniform for bounds much smaller than DIGIT_MAX. bound
+    must not be 0.
   */
-  bool mbiSub( bigintlength n, bigint* dest, const bigint* sub, bool* carry )
+  bigint mbiRandomBelow( bigintrandom* r, bigint bound )
+  {
+    return mbiRandomDigit( r ) % bound;
+  }
+  
+  /*
+  * Fills a Big Int with random digits
+  * Remark: z has n digits, all bits are random. The lanes are kept in
+    local copies, so the stores to z cannot alias the state and the loop
+    over the lanes vectorizes; a tail shorter than the lanes uses up one
+    full round.
+  */
+  void mbiRandomFill( bigintrandom* r, bigintlength n, bigint* z )
   {
+    uint64_t s0[MBI_RANDOM_LANES], s1[MBI_RANDOM_LANES], s2[MBI_RANDOM_LANES], s3[MBI_RANDOM_LANES];
+    uint64_t out[MBI_RANDOM_LANES];
+    memcpy( s0, r->s[0], sizeof(s0) );
+    memcpy( s1, r->s[1], sizeof(s1) );
+    memcpy( s2, r->s[2], sizeof(s2) );
+    memcpy( s3, r->s[3], sizeof(s3) );
     
-    bigint z;
-    bigintlength i;
-    for( i = 0; i < n; i++ )
+    for( bigintlength i = 0; i < n; i += MBI_RANDOM_LANES )
     {
-    
-      z = dest[i];
-      z -= sub[i];
-      if( *carry ) z--;
-      
-      if( ( !*carry && dest[i] < z ) || ( *carry && dest[i] <= z ) )
-        *carry = true;
-      else
-        *carry = false;
-      
-      dest[i] = z;
+      for( unsigned int k = 0; k < MBI_RANDOM_LANES; k++ )
+      {
+        uint64_t w = s0[k] + s3[k];
+        out[k] = ( ( w << 23 ) | ( w >> 41 ) ) + s0[k];
+        uint64_t t = s1[k] << 17;
+        s2[k] ^= s0[k];
+        s3[k] ^= s1[k];
+        s1[k] ^= s2[k];
+        s0[k] ^= s3[k];
+        s2[k] ^= t;
+        s3[k] = ( s3[k] << 45 ) | ( s3[k] >> 19 );
+      }
       
+      if( i + MBI_RANDOM_LANES <= n ){
+        for( unsigned int k = 0; k < MBI_RANDOM_LANES; k++ )
+          z[i+k] = (bigint)out[k];
+      }else{
+        for( unsigned int k = 0; i + k < n; k++ )
+          z[i+k] = (bigint)out[k];
+      }
     }
     
-    return *carry;
-    
+    memcpy( r->s[0], s0, sizeof(s0) );
+    memcpy( r->s[1], s1, sizeof(s1) );
+    memcpy( r->s[2], s2, sizeof(s2) );
+    memcpy( r->s[3], s3, sizeof(s3) );
   }
   
-  
   /*
-  * Adds to big ints, saves the result and takes into account the carry.
-  * Remark: Works like Add, but with two summands and an argument for a
-    pointer the sum is written to. dest and add1 are allowed to point to
-    the same block of memory
+  * Fills a Big Int with a structured pattern
+  * Remark: z has n digits and pattern is one of MBI_PATTERN_*. The
+    patterns hit the long carry chains and the special cases that uniform
+    digits almost never produce; the random parts, like the place of the
+    single bit, come from r.
   */
-  /* EXTRA */
-  /* NOT TESTED */
-  bool mbiCopySub( bigintlength n, bigint* dest, const bigint* add1, const bigint* add2, bool* carry )
+  void mbiRandomPattern( bigintrandom* r, bigintlength n, bigint* z, int pattern )
   {
-    assert( add2 != dest );
-    bigint z;
-    bigintlength i;
-    for( i = 0; i < n; i++ )
-    {
+    if( n == 0 ) return;
     
-      z = add1[i];
-      z -= add2[i];
-      if( *carry ) z--;
-      
-      if( ( !*carry && add1[i] < z ) || ( *carry && add1[i] <= z ) )
-        *carry = true;
-      else
-        *carry = false;
+    switch( pattern )
+    {
+      case MBI_PATTERN_MAX:
+        mbiSetDigits( n, z, DIGIT_MAX );
+        break;
+        
+      case MBI_PATTERN_BIT:
+      {
+        bigint p = mbiRandomBelow( r, n * DIGIT_BITS );
+        mbiSetZero( n, z );
+        z[p / DIGIT_BITS] = (bigint)1 << ( p % DIGIT_BITS );
+        break;
+      }
       
-      dest[i] = z;
+      case MBI_PATTERN_ALTERNATING:
+        for( bigintlength i = 0; i < n; i++ )
+          z[i] = ( i % 2 == 0 ) ? DIGIT_MAX : 0;
+        break;
+        
+      case MBI_PATTERN_SPARSE:
+        mbiSetZero( n, z );
+        for( bigintlength i = n / 16 + 1; i > 0; i-- )
+          z[mbiRandomBelow( r, n )] = mbiRandomDigit( r );
+        break;
+        
+      case MBI_PATTERN_NEAR_POWER:
+      {
+        bigint d = mbiRandomDigit( r ) >> ( DIGIT_BITS / 2 );
+        if( mbiRandomDigit( r ) & 1 ){
+          mbiSetDigits( n, z, DIGIT_MAX );
+          z[0] -= d;
+        }else{
+          mbiSetZero( n, z );
+          z[n-1] = (bigint)1 << ( DIGIT_BITS - 1 );
+          z[0] += d;
+        }
+        break;
+      }
       
+      default:
+        mbiRandomFill( r, n, z );
+        break;
     }
-    
-    return *carry;
+  }
+
+  
+  
+  
+  /*********************************************/
+  /* Bit operations                            */
+  /*********************************************/
+  
+  /*
+  * The kernels below have an AVX-512 and an AVX2 variant, which are chosen
+  * at compile time (e.g. -mavx2 or -march=native), and a portable variant
+  * for everything else. All of them stream through memory once and use
+  * unaligned loads, so no particular alignment of the Big Ints is needed.
+  */
+  
+  
+  /*
+  * Counts the leading zero bits of a single digit
+  * Remark: Returns DIGIT_BITS for d = 0
+  */
+  unsigned int mbiDigitLeadingZeros( bigint d )
+  {
+    if( d == 0 ) return DIGIT_BITS;
+  #if defined(__GNUC__)
+    return (unsigned int)__builtin_clzl( d );
+  #else
+    unsigned int c = 0;
+    while( ( d & ( ((bigint)1) << (DIGIT_BITS-1) ) ) == 0 ){ d <<= 1; c++; }
+    return c;
+  #endif
   }
   
+  /*
+  * Counts the trailing zero bits of a single digit
+  * Remark: Returns DIGIT_BITS for d = 0
+  */
+  unsigned int mbiDigitTrailingZeros( bigint d )
+  {
+    if( d == 0 ) return DIGIT_BITS;
+  #if defined(__GNUC__)
+    return (unsigned int)__builtin_ctzl( d );
+  #else
+    unsigned int c = 0;
+    while( ( d & 1 ) == 0 ){ d >>= 1; c++; }
+    return c;
+  #endif
+  }
   
   /*
-  * Increments a big int, taking into account the carry.
-  * Remark: dest points to a Big Int of length n. dest is incremented by 1.
-    carry points to a boolean value which (i) gives input, whether 1 shall be
-    added to the sum or not (ii) whether there has been an overflow has taken
-    place during execution (1) or not (0). It's a simulation of a
-    carry-save-adder.
+  * Counts the set bits of a single digit
+  * Remark: None
   */
-  /* EXTRA */
-  bool mbiDec( bigintlength n, bigint* dest, bool* carry )
+  unsigned int mbiDigitPopCount( bigint d )
   {
+  #if defined(__GNUC__)
+    return (unsigned int)__builtin_popcountl( d );
+  #else
+    unsigned int c = 0;
+    for( ; d != 0; d &= d - 1 ) c++;
+    return c;
+  #endif
+  }
+  
+  
+  /*
+  * Shifts a Big Int to the left by less than one digit
+  * Remark: Computes dest[i] = src[i] << s | src[i-1] >> (DIGIT_BITS-s) for
+    0 < s < DIGIT_BITS, zeros are shifted in at the bottom. The digits are
+    processed from the top downwards, so dest may be equal to src or lie
+    above it. Returns the bits shifted out of the top digit.
+  */
+  bigint mbiFunnelLeftShift( bigintlength n, bigint* dest, const bigint* src, unsigned int s )
+  {
+    assert( n > 0 );
+    assert( 0 < s && s < DIGIT_BITS );
     
-    bigintlength i;
-    
-    dest[0]--;
-    if( dest[0] == (bigint)DIGIT_MAX ) *carry = true;
+    bigint out = src[n-1] >> (DIGIT_BITS-s);
+    bigintlength i = n;
     
-    for( i = 1; *carry == true && i < n; i++ )
+  #if defined(__AVX512F__)
     {
-      dest[i]--;
-      if( dest[i] == (bigint)DIGIT_MAX ) *carry = true;
-      else *carry = false;
+      __m128i cl = _mm_cvtsi32_si128( (int)s );
+      __m128i cr = _mm_cvtsi32_si128( (int)(DIGIT_BITS-s) );
+      while( i > 8 )
+      {
+        i -= 8;
+        __m512i hi = _mm512_loadu_si512( (const void*)(src+i) );
+        __m512i lo = _mm512_loadu_si512( (const void*)(src+i-1) );
+        _mm512_storeu_si512( (void*)(dest+i), _mm512_or_si512( _mm512_sll_epi64( hi, cl ), _mm512_srl_epi64( lo, cr ) ) );
+      }
+    }
+  #elif defined(__AVX2__)
+    {
+      __m128i cl = _mm_cvtsi32_si128( (int)s );
+      __m128i cr = _mm_cvtsi32_si128( (int)(DIGIT_BITS-s) );
+      while( i > 4 )
+      {
+        i -= 4;
+        __m256i hi = _mm256_loadu_si256( (const __m256i*)(src+i) );
+        __m256i lo = _mm256_loadu_si256( (const __m256i*)(src+i-1) );
+        _mm256_storeu_si256( (__m256i*)(dest+i), _mm256_or_si256( _mm256_sll_epi64( hi, cl ), _mm256_srl_epi64( lo, cr ) ) );
+      }
     }
+  #endif
     
-    return *carry;
+    for( ; i > 1; i-- )
+      dest[i-1] = ( src[i-1] << s ) | ( src[i-2] >> (DIGIT_BITS-s) );
+    dest[0] = src[0] << s;
     
+    return out;
   }
   
-
-
-  
-  
-
-  
-  
-  /*********************************************/
-  /* Other multiplication operations           */
-  /*********************************************/
-
-
-
   /*
-  * Multiplies to Big ints according to basic school method
-  * Remark: Bigints a and b must have the same length, which must be of
-    form 2^{k}. p points to a Bigint of double size - 2^{k+1} - the
-    result is saved in.
+  * Shifts a Big Int to the right by less than one digit
+  * Remark: Computes dest[i] = src[i] >> s | src[i+1] << (DIGIT_BITS-s) for
+    0 < s < DIGIT_BITS, zeros are shifted in at the top. The digits are
+    processed from the bottom upwards, so dest may be equal to src or lie
+    below it. Returns the bits shifted out of the lowest digit, which are
+    left-aligned in the returned digit.
   */
-  void mbiNaivMultiplication( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  bigint mbiFunnelRightShift( bigintlength n, bigint* dest, const bigint* src, unsigned int s )
   {
+    assert( n > 0 );
+    assert( 0 < s && s < DIGIT_BITS );
     
-    bigintlength i, j;
-    bigintlength length = 1 << k;
-    
-    mbiSetZero( length*2, p );
+    bigint out = src[0] << (DIGIT_BITS-s);
+    bigintlength i = 0;
     
-    /* Collect the carries and add them later */
-    bigint* overflows = malloc( sizeof(bigint)*length*2 );
+  #if defined(__AVX512F__)
+    {
+      __m128i cr = _mm_cvtsi32_si128( (int)s );
+      __m128i cl = _mm_cvtsi32_si128( (int)(DIGIT_BITS-s) );
+      for( ; i + 8 < n; i += 8 )
+      {
+        __m512i lo = _mm512_loadu_si512( (const void*)(src+i) );
+        __m512i hi = _mm512_loadu_si512( (const void*)(src+i+1) );
+        _mm512_storeu_si512( (void*)(dest+i), _mm512_or_si512( _mm512_srl_epi64( lo, cr ), _mm512_sll_epi64( hi, cl ) ) );
+      }
+    }
+  #elif defined(__AVX2__)
+    {
+      __m128i cr = _mm_cvtsi32_si128( (int)s );
+      __m128i cl = _mm_cvtsi32_si128( (int)(DIGIT_BITS-s) );
+      for( ; i + 4 < n; i += 4 )
+      {
+        __m256i lo = _mm256_loadu_si256( (const __m256i*)(src+i) );
+        __m256i hi = _mm256_loadu_si256( (const __m256i*)(src+i+1) );
+        _mm256_storeu_si256( (__m256i*)(dest+i), _mm256_or_si256( _mm256_srl_epi64( lo, cr ), _mm256_sll_epi64( hi, cl ) ) );
+      }
+    }
+  #endif
+    
+    for( ; i + 1 < n; i++ )
+      dest[i] = ( src[i] >> s ) | ( src[i+1] << (DIGIT_BITS-s) );
+    dest[n-1] = src[n-1] >> s;
+    
+    return out;
+  }
+  
+  
+  /*
+  * Performs right shift, bit-wise precision
+  * Remarks: Shifts by n digits or more are allowed. If setzero is false, the
+    digits vacated by the digit-wise part of the shift are left untouched.
+  */
+  void mbiBitRightShift( bigintlength n, bigint* z, unsigned long r, bool setzero )
+  {
+    bigintlength q = r / DIGIT_BITS;
+    if( q > n ) q = n;
+    if( q > 0 ) mbiRightShift( n, z, q, setzero );
+    r %= DIGIT_BITS;
+    if( r != 0 && n > q ) mbiFunnelRightShift( setzero ? n : n - q, z, z, (unsigned int)r );
+  }
+  
+  /*
+  * Performs left shift, bitwise-precision
+  * Remarks: Shifts by n digits or more are allowed.
+  */
+  void mbiBitLeftShift( bigintlength n, bigint* z, unsigned long r )
+  {
+    bigintlength q = r / DIGIT_BITS;
+    if( q > n ) q = n;
+    if( q > 0 ) mbiLeftShift( n, z, q );
+    r %= DIGIT_BITS;
+    if( r != 0 && n > q ) mbiFunnelLeftShift( n - q, z + q, z + q, (unsigned int)r );
+  }
+  
+  /*
+  * Performs left shift into a separate Big Int, bitwise-precision
+  * Remarks: dest and src both have n digits, dest receives the lower n
+    digits of src shifted by r bits. dest may equal src. Shifts by n digits
+    or more are allowed.
+  */
+  void mbiBitLeftShiftCopy( bigintlength n, bigint* dest, const bigint* src, unsigned long r )
+  {
+    bigintlength q = r / DIGIT_BITS;
+    unsigned int s = (unsigned int)( r % DIGIT_BITS );
+    if( q >= n ){
+      mbiSetZero( n, dest );
+      return;
+    }
+    if( s != 0 )
+      mbiFunnelLeftShift( n - q, dest + q, src, s );
+    else
+      for( bigintlength i = n - q; i > 0; i-- ) dest[q+i-1] = src[i-1];
+    mbiSetZero( q, dest );
+  }
+  
+  /*
+  * Performs right shift into a separate Big Int, bitwise-precision
+  * Remarks: dest and src both have n digits, dest receives src shifted by r
+    bits with zeros filled in at the top. dest may equal src. Shifts by n
+    digits or more are allowed.
+  */
+  void mbiBitRightShiftCopy( bigintlength n, bigint* dest, const bigint* src, unsigned long r )
+  {
+    bigintlength q = r / DIGIT_BITS;
+    unsigned int s = (unsigned int)( r % DIGIT_BITS );
+    if( q >= n ){
+      mbiSetZero( n, dest );
+      return;
+    }
+    if( s != 0 )
+      mbiFunnelRightShift( n - q, dest, src + q, s );
+    else
+      for( bigintlength i = 0; i < n - q; i++ ) dest[i] = src[i+q];
+    mbiSetZero( q, dest + n - q );
+  }
+  
+  
+  /*
+  * Bitwise logic of two Big Ints
+  * Remark: dest, a and b point to Big Ints of length n, dest receives
+    a & b, a | b or a ^ b, respectively. dest may equal a or b.
+  */
+  #if defined(__AVX512F__)
+  #define MBI_BITWISE_LOOP( OP512, OP256, OP ) \
+    for( ; i + 8 <= n; i += 8 ) \
+      _mm512_storeu_si512( (void*)(dest+i), OP512( _mm512_loadu_si512( (const void*)(a+i) ), _mm512_loadu_si512( (const void*)(b+i) ) ) ); \
+    for( ; i < n; i++ ) dest[i] = a[i] OP b[i];
+  #elif defined(__AVX2__)
+  #define MBI_BITWISE_LOOP( OP512, OP256, OP ) \
+    for( ; i + 4 <= n; i += 4 ) \
+      _mm256_storeu_si256( (__m256i*)(dest+i), OP256( _mm256_loadu_si256( (const __m256i*)(a+i) ), _mm256_loadu_si256( (const __m256i*)(b+i) ) ) ); \
+    for( ; i < n; i++ ) dest[i] = a[i] OP b[i];
+  #else
+  #define MBI_BITWISE_LOOP( OP512, OP256, OP ) \
+    for( ; i < n; i++ ) dest[i] = a[i] OP b[i];
+  #endif
+  
+  void mbiAnd( bigintlength n, bigint* dest, const bigint* a, const bigint* b )
+  {
+    bigintlength i = 0;
+    MBI_BITWISE_LOOP( _mm512_and_si512, _mm256_and_si256, & )
+  }
+  
+  void mbiOr( bigintlength n, bigint* dest, const bigint* a, const bigint* b )
+  {
+    bigintlength i = 0;
+    MBI_BITWISE_LOOP( _mm512_or_si512, _mm256_or_si256, | )
+  }
+  
+  void mbiXor( bigintlength n, bigint* dest, const bigint* a, const bigint* b )
+  {
+    bigintlength i = 0;
+    MBI_BITWISE_LOOP( _mm512_xor_si512, _mm256_xor_si256, ^ )
+  }
+  
+  #undef MBI_BITWISE_LOOP
+  
+  /*
+  * Bitwise complement of a Big Int
+  * Remark: dest and src point to Big Ints of length n, dest may equal src.
+  */
+  void mbiNot( bigintlength n, bigint* dest, const bigint* src )
+  {
+    bigintlength i = 0;
+  #if defined(__AVX512F__)
+    __m512i ones = _mm512_set1_epi64( -1 );
+    for( ; i + 8 <= n; i += 8 )
+      _mm512_storeu_si512( (void*)(dest+i), _mm512_xor_si512( _mm512_loadu_si512( (const void*)(src+i) ), ones ) );
+  #elif defined(__AVX2__)
+    __m256i ones = _mm256_set1_epi64x( -1 );
+    for( ; i + 4 <= n; i += 4 )
+      _mm256_storeu_si256( (__m256i*)(dest+i), _mm256_xor_si256( _mm256_loadu_si256( (const __m256i*)(src+i) ), ones ) );
+  #endif
+    for( ; i < n; i++ ) dest[i] = ~src[i];
+  }
+  
+  
+  /*
+  * Counts the set bits of a Big Int
+  * Remark: The AVX2 variant uses the nibble lookup of Mula et al. and sums
+    the bytes with psadbw; it is flushed every 31 rounds so no byte counter
+    can overflow.
+  */
+  unsigned long mbiPopCount( bigintlength n, const bigint* z )
+  {
+    unsigned long c = 0;
+    bigintlength i = 0;
+    
+  #if defined(__AVX512VPOPCNTDQ__)
+    {
+      __m512i acc = _mm512_setzero_si512();
+      for( ; i + 8 <= n; i += 8 )
+        acc = _mm512_add_epi64( acc, _mm512_popcnt_epi64( _mm512_loadu_si512( (const void*)(z+i) ) ) );
+      c += (unsigned long)_mm512_reduce_add_epi64( acc );
+    }
+  #elif defined(__AVX2__)
+    {
+      const __m256i table = _mm256_setr_epi8( 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4 );
+      const __m256i low4 = _mm256_set1_epi8( 0x0f );
+      __m256i total = _mm256_setzero_si256();
+      while( i + 4 <= n )
+      {
+        __m256i bytes = _mm256_setzero_si256();
+        for( int r = 0; r < 31 && i + 4 <= n; r++, i += 4 )
+        {
+          __m256i v  = _mm256_loadu_si256( (const __m256i*)(z+i) );
+          __m256i lo = _mm256_and_si256( v, low4 );
+          __m256i hi = _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low4 );
+          bytes = _mm256_add_epi8( bytes, _mm256_add_epi8( _mm256_shuffle_epi8( table, lo ), _mm256_shuffle_epi8( table, hi ) ) );
+        }
+        total = _mm256_add_epi64( total, _mm256_sad_epu8( bytes, _mm256_setzero_si256() ) );
+      }
+      c += (unsigned long)( _mm256_extract_epi64( total, 0 ) + _mm256_extract_epi64( total, 1 )
+                          + _mm256_extract_epi64( total, 2 ) + _mm256_extract_epi64( total, 3 ) );
+    }
+  #endif
+    
+    for( ; i < n; i++ ) c += mbiDigitPopCount( z[i] );
+    return c;
+  }
+  
+  /*
+  * Counts the leading zero bits of a Big Int
+  * Remark: z has n digits, so the result is n*DIGIT_BITS if z is zero.
+    Blocks of zero digits are skipped vector-wise.
+  */
+  unsigned long mbiCountLeadingZeros( bigintlength n, const bigint* z )
+  {
+    bigintlength i = n;
+    
+  #if defined(__AVX512F__)
+    while( i >= 8 && _mm512_test_epi64_mask( _mm512_loadu_si512( (const void*)(z+i-8) ), _mm512_loadu_si512( (const void*)(z+i-8) ) ) == 0 )
+      i -= 8;
+  #elif defined(__AVX2__)
+    while( i >= 4 && _mm256_testz_si256( _mm256_loadu_si256( (const __m256i*)(z+i-4) ), _mm256_loadu_si256( (const __m256i*)(z+i-4) ) ) )
+      i -= 4;
+  #endif
+    
+    while( i > 0 && z[i-1] == 0 ) i--;
+    if( i == 0 ) return n * DIGIT_BITS;
+    return ( n - i ) * DIGIT_BITS + mbiDigitLeadingZeros( z[i-1] );
+  }
+  
+  /*
+  * Counts the trailing zero bits of a Big Int
+  * Remark: z has n digits, so the result is n*DIGIT_BITS if z is zero.
+    Blocks of zero digits are skipped vector-wise.
+  */
+  unsigned long mbiCountTrailingZeros( bigintlength n, const bigint* z )
+  {
+    bigintlength i = 0;
+    
+  #if defined(__AVX512F__)
+    while( i + 8 <= n && _mm512_test_epi64_mask( _mm512_loadu_si512( (const void*)(z+i) ), _mm512_loadu_si512( (const void*)(z+i) ) ) == 0 )
+      i += 8;
+  #elif defined(__AVX2__)
+    while( i + 4 <= n && _mm256_testz_si256( _mm256_loadu_si256( (const __m256i*)(z+i) ), _mm256_loadu_si256( (const __m256i*)(z+i) ) ) )
+      i += 4;
+  #endif
+    
+    while( i < n && z[i] == 0 ) i++;
+    if( i == n ) return n * DIGIT_BITS;
+    return i * DIGIT_BITS + mbiDigitTrailingZeros( z[i] );
+  }
+  
+  /*
+  * Reads a bit field of a Big Int
+  * Remark: Returns the w <= DIGIT_BITS bits of z from bit position pos on,
+    z has n digits and bits above them are read as zero.
+  */
+  bigint mbiGetBitField( bigintlength n, const bigint* z, unsigned long pos, unsigned int w )
+  {
+    bigintlength i = pos / DIGIT_BITS;
+    unsigned int o = pos % DIGIT_BITS;
+    if( i >= n ) return 0;
+    
+    bigint v = z[i] >> o;
+    if( o != 0 && o + w > DIGIT_BITS && i + 1 < n ) v |= z[i+1] << ( DIGIT_BITS - o );
+    if( w < DIGIT_BITS ) v &= ( (bigint)1 << w ) - 1;
+    return v;
+  }
+  
+  /*
+  * Sets bits of a Big Int
+  * Remark: The value v < 2^w, w <= DIGIT_BITS, is or-ed into z from bit
+    position pos on. z must have a digit for the highest bit of the field.
+  */
+  void mbiOrBitField( bigint* z, unsigned long pos, unsigned int w, bigint v )
+  {
+    bigintlength i = pos / DIGIT_BITS;
+    unsigned int o = pos % DIGIT_BITS;
+    
+    z[i] |= v << o;
+    if( o != 0 && o + w > DIGIT_BITS ) z[i+1] |= v >> ( DIGIT_BITS - o );
+  }
+  
+  /*
+  * Reads consecutive bit fields of a Big Int
+  * Remark: out[j] gets the field of w <= DIGIT_BITS bits at position j*w,
+    for j < count, like GetBitField. The AVX2 variant reads four fields at
+    once with gathers, as long as the digit above each field is inside z.
+  */
+  void mbiGetBitFields( bigintlength n, const bigint* z, unsigned int w, size_t count, bigint* out )
+  {
+    size_t j = 0;
+    
+  #if defined(__AVX2__)
+    if( n > 1 ){
+      
+      /* slots whose digit and the one above it are both inside z */
+      size_t safe = ( ( n - 1 ) * DIGIT_BITS + w - 1 ) / w;
+      if( safe > count ) safe = count;
+      
+      const __m256i mask = _mm256_set1_epi64x( w < DIGIT_BITS ? (long long)( ( (bigint)1 << w ) - 1 ) : -1LL );
+      const __m256i step = _mm256_set1_epi64x( 4 * (long long)w );
+      const __m256i bits = _mm256_set1_epi64x( DIGIT_BITS );
+      const __m256i low  = _mm256_set1_epi64x( DIGIT_BITS - 1 );
+      __m256i pos = _mm256_set_epi64x( 3 * (long long)w, 2 * (long long)w, (long long)w, 0 );
+      
+      for( ; j + 4 <= safe; j += 4 )
+      {
+        __m256i i  = _mm256_srli_epi64( pos, 6 );
+        __m256i o  = _mm256_and_si256( pos, low );
+        __m256i lo = _mm256_i64gather_epi64( (const long long*)z, i, 8 );
+        __m256i hi = _mm256_i64gather_epi64( (const long long*)( z + 1 ), i, 8 );
+        
+        /* shifts by DIGIT_BITS give zero, so o = 0 needs no special case */
+        __m256i v = _mm256_or_si256( _mm256_srlv_epi64( lo, o ), _mm256_sllv_epi64( hi, _mm256_sub_epi64( bits, o ) ) );
+        _mm256_storeu_si256( (__m256i*)( out + j ), _mm256_and_si256( v, mask ) );
+        pos = _mm256_add_epi64( pos, step );
+      }
+      
+    }
+  #endif
+    
+    for( ; j < count; j++ ) out[j] = mbiGetBitField( n, z, (unsigned long)j * w, w );
+  }
+
+  
+  
+
+  /**************************/
+  /* Elementary Arithmetics */
+  /**************************/
+
+  /*
+  * Multiplies two digits
+  * Remark: Returns the lower digit of the double-digit product a*b, the
+    upper digit is written to hi. Uses a 128 bit type where the compiler
+    has one, and a product of half-digits otherwise.
+  */
+  bigint mbiMulDigits( bigint a, bigint b, bigint* hi )
+  {
+  #if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 bigintdouble;
+    bigintdouble w = (bigintdouble)a * b;
+    *hi = (bigint)( w >> DIGIT_BITS );
+    return (bigint)w;
+  #else
+    const unsigned int h = DIGIT_BITS / 2;
+    const bigint mask = DIGIT_MAX >> h;
+    bigint a0 = a & mask, a1 = a >> h;
+    bigint b0 = b & mask, b1 = b >> h;
+    bigint w00 = a0 * b0, w01 = a0 * b1, w10 = a1 * b0, w11 = a1 * b1;
+    bigint mid = ( w00 >> h ) + ( w01 & mask ) + ( w10 & mask );
+    *hi = w11 + ( w01 >> h ) + ( w10 >> h ) + ( mid >> h );
+    return ( mid << h ) | ( w00 & mask );
+  #endif
+  }
+  
+  /*
+  * Divides a double digit by a digit
+  * Remark: Returns the quotient of hi*B + lo by d, the remainder is written
+    to rem. hi must be less than d, so the quotient fits into a digit.
+  */
+  bigint mbiDivDigits( bigint hi, bigint lo, bigint d, bigint* rem )
+  {
+    assert( hi < d );
+  #if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 bigintdouble;
+    bigintdouble w = ( (bigintdouble)hi << DIGIT_BITS ) | lo;
+    *rem = (bigint)( w % d );
+    return (bigint)( w / d );
+  #else
+    bigint q = 0;
+    for( unsigned int i = 0; i < DIGIT_BITS; i++ )
+    {
+      bool top = ( hi >> ( DIGIT_BITS - 1 ) ) != 0;
+      hi = ( hi << 1 ) | ( lo >> ( DIGIT_BITS - 1 ) );
+      lo <<= 1;
+      q <<= 1;
+      if( top || hi >= d ){
+        hi -= d;
+        q |= 1;
+      }
+    }
+    *rem = hi;
+    return q;
+  #endif
+  }
+  
+  /*
+  * A digit with its reciprocal for division by multiplication
+  * Remark: norm is d shifted left until its top bit is set, and v is
+    floor((B^2 - 1) / norm) - B, the reciprocal after Moeller and
+    Granlund, which turns each division of a double digit into two
+    products and a few corrections.
+  */
+  typedef struct {
+    bigint d;
+    bigint norm;
+    bigint v;
+    unsigned int shift;
+  } bigintreciprocal;
+  
+  /*
+  * Computes the reciprocal of a digit
+  * Remark: d must not be zero. This costs one division.
+  */
+  void mbiReciprocalInit( bigintreciprocal* r, bigint d )
+  {
+    assert( d != 0 );
+    bigint rem;
+    r->d     = d;
+    r->shift = mbiDigitLeadingZeros( d );
+    r->norm  = d << r->shift;
+    r->v     = mbiDivDigits( ~r->norm, DIGIT_MAX, r->norm, &rem );
+  }
+  
+  /*
+  * Divides a double digit by a normalized digit with its reciprocal
+  * Remark: Like DivDigits for d = r->norm, hi must be less than r->norm.
+  */
+  bigint mbiDivDigitsPre( bigint hi, bigint lo, const bigintreciprocal* r, bigint* rem )
+  {
+    bigint q1, q0 = mbiMulDigits( r->v, hi, &q1 );
+    q0 += lo;
+    q1 += hi + 1 + ( q0 < lo );
+    bigint t = lo - q1 * r->norm;
+    if( t > q0 ){
+      q1--;
+      t += r->norm;
+    }
+    if( t >= r->norm ){
+      q1++;
+      t -= r->norm;
+    }
+    *rem = t;
+    return q1;
+  }
+  
+
+  /*
+  * Adds a big int to another big int, taking into account the carry.
+  * Remark: dest and add point to Big Int of length n. add is added onto dest.
+    carry points to a boolean value which (i) gives input, whether 1 shall
+    be added to the sum or not (ii) whether there has been an overflow has
+    taken place during execution (1) or not (0). It's a simulation of a
+    carry-save-adder.
+  */
+  bool mbiAdd( bigintlength n, bigint* dest, const bigint* add, bool* carry )
+  {
+    
+    bigintlength i;
+    for( i = 0; i < n; i++ )
+    {
+      dest[i] += add[i];
+      if( *carry ) dest[i]++;
+      if( ( !(*carry) && add[i] > dest[i] ) || ( *carry && add[i] >= dest[i] ) )
+        *carry = true;
+      else
+        *carry = false;
+    }
+    
+    return *carry;
+  }
+  
+  
+  
+  /*
+  * Adds to big ints, saves the result and takes into account the carry.
+  * Remark: Works like Add, but with two summands and an argument for a
+    pointer the sum is written to. dest and add1 are allowed to point to
+    the same block of memory
+  */
+  bool mbiCopyAdd( bigintlength n, bigint* dest, const bigint* add1, const bigint* add2, bool* carry )
+  {
+    assert( add2 != dest );
+    bigintlength i;
+    for( i = 0; i < n; i++ )
+    {
+      dest[i] = add1[i] + add2[i];
+      if( *carry ) dest[i]++;
+      
+      if( ( !(*carry) && add2[i] > dest[i] ) || ( *carry && add2[i] >= dest[i] ) )
+        *carry = true;
+      else
+        *carry = false;
+    }
+    
+    return *carry;
+  }
+  
+  
+  /*
+  * Increments a big int, taking into account the carry.
+  * Remark: dest points to a Big Int of length n. dest is incremented by 1.
+    carry points to a boolean value which (i) gives input, whether 1 shall be
+    added to the sum or not (ii) whether there has been an overflow has taken
+    place during execution (1) or not (0). It's a simulation of a
+    carry-save-adder.
+  */
+  bool mbiInc( bigintlength n, bigint* dest, bool* carry )
+  {
+    
+    bigintlength i;
+    
+    dest[0]++;
+    *carry = ( dest[0] == (bigint)0 );
+    
+    for( i = 1; *carry == true && i < n; i++ )
+    {
+      dest[i]++;
+      if( dest[i] == (bigint)0 ) *carry = true;
+      else *carry = false;
+    }
+    
+    return *carry;
+    
+  }
+  
+  
+  
+  /*
+  * Subtracts a big int from another big int, taking into account the carry.
+  * Remark: dest and sub point to Big Int of length n. sub is subtracted
+    from dest. carry points to a boolean value which (i) gives input,
+    whether 1 shall be drawn from the difference or not (ii) whether there
+    has been an overflow has taken place during execution (1) or not (0).
+    It's a simulation of a carry-save-adder.
+  */
+  bool mbiSub( bigintlength n, bigint* dest, const bigint* sub, bool* carry )
+  {
+    
+    bigint z;
+    bigintlength i;
+    for( i = 0; i < n; i++ )
+    {
+    
+      z = dest[i];
+      z -= sub[i];
+      if( *carry ) z--;
+      
+      if( ( !*carry && dest[i] < z ) || ( *carry && dest[i] <= z ) )
+        *carry = true;
+      else
+        *carry = false;
+      
+      dest[i] = z;
+      
+    }
+    
+    return *carry;
+    
+  }
+  
+  
+  /*
+  * Adds to big ints, saves the result and takes into account the carry.
+  * Remark: Works like Add, but with two summands and an argument for a
+    pointer the sum is written to. dest and add1 are allowed to point to
+    the same block of memory
+  */
+  /* EXTRA */
+  bool mbiCopySub( bigintlength n, bigint* dest, const bigint* add1, const bigint* add2, bool* carry )
+  {
+    assert( add2 != dest );
+    bigint z;
+    bigintlength i;
+    for( i = 0; i < n; i++ )
+    {
+    
+      z = add1[i];
+      z -= add2[i];
+      if( *carry ) z--;
+      
+      if( ( !*carry && add1[i] < z ) || ( *carry && add1[i] <= z ) )
+        *carry = true;
+      else
+        *carry = false;
+      
+      dest[i] = z;
+      
+    }
+    
+    return *carry;
+  }
+  
+  /*
+  * Increments a big int, taking into account the carry.
+  * Remark: dest points to a Big Int of length n. dest is incremented by 1.
+    carry points to a boolean value which (i) gives input, whether 1 shall be
+    added to the sum or not (ii) whether there has been an overflow has taken
+    place during execution (1) or not (0). It's a simulation of a
+    carry-save-adder.
+  */
+  /* EXTRA */
+  bool mbiDec( bigintlength n, bigint* dest, bool* carry )
+  {
+    
+    bigintlength i;
+    
+    dest[0]--;
+    *carry = ( dest[0] == (bigint)DIGIT_MAX );
+    
+    for( i = 1; *carry == true && i < n; i++ )
+    {
+      dest[i]--;
+      if( dest[i] == (bigint)DIGIT_MAX ) *carry = true;
+      else *carry = false;
+    }
+    
+    return *carry;
+    
+  }
+  
+  /*
+  * Absolute difference of two Big Ints
+  * Remark: dest = |a - b|, where a has n1 digits, b has n2 >= n1 digits
+    and dest has n2 digits. Returns true if a < b, i.e. if the difference
+    is negative. dest must not overlap with a or b.
+  */
+  bool mbiCopyAbsSub( bigintlength n1, bigint* dest, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    bool carry = false;
+    bool negative = !mbiIsZero( n2 - n1, b + n1 ) || mbiCompare( n1, a, b ) < 0;
+    
+    if( negative ){
+      mbiCopySub( n1, dest, b, a, &carry );
+      if( n2 > n1 ){
+        mbiCopy( n2 - n1, dest + n1, b + n1 );
+        if( carry ) mbiDec( n2 - n1, dest + n1, &carry );
+      }
+    }else{
+      mbiCopySub( n1, dest, a, b, &carry );
+      mbiSetZero( n2 - n1, dest + n1 );
+    }
+    
+    return negative;
+  }
+  
+  /*
+  * Adds a single digit to a Big Int
+  * Remark: dest has n digits, d is added and the carry is propagated up to
+    the top. Returns true if it runs out of dest.
+  */
+  bool mbiAddDigit( bigintlength n, bigint* dest, bigint d )
+  {
+    if( n == 0 ) return d != 0;
+    dest[0] += d;
+    if( dest[0] >= d ) return false;
+    bool carry = false;
+    return n > 1 ? mbiInc( n-1, dest+1, &carry ) : true;
+  }
+  
+  /*
+  * Subtracts a single digit from a Big Int
+  * Remark: dest has n digits, d is subtracted and the borrow is propagated
+    up to the top. Returns true if it runs out of dest.
+  */
+  bool mbiSubDigit( bigintlength n, bigint* dest, bigint d )
+  {
+    if( n == 0 ) return d != 0;
+    bigint z = dest[0];
+    dest[0] -= d;
+    if( z >= d ) return false;
+    bool carry = false;
+    return n > 1 ? mbiDec( n-1, dest+1, &carry ) : true;
+  }
+  
+  /*
+  * Adds a Big Int onto a longer one
+  * Remark: src has n and dest has nd >= n digits. The carry is propagated
+    up to the top of dest, returns true if it runs out of dest.
+  */
+  bool mbiAddInto( bigintlength nd, bigint* dest, bigintlength n, const bigint* src )
+  {
+    bool carry = false;
+    mbiAdd( n, dest, src, &carry );
+    if( !carry ) return false;
+    carry = false;
+    return nd > n ? mbiInc( nd - n, dest + n, &carry ) : true;
+  }
+  
+  /*
+  * Subtracts a Big Int from a longer one
+  * Remark: src has n and dest has nd >= n digits. The borrow is propagated
+    up to the top of dest, returns true if it runs out of dest.
+  */
+  bool mbiSubFrom( bigintlength nd, bigint* dest, bigintlength n, const bigint* src )
+  {
+    bool carry = false;
+    mbiSub( n, dest, src, &carry );
+    if( !carry ) return false;
+    carry = false;
+    return nd > n ? mbiDec( nd - n, dest + n, &carry ) : true;
+  }
+  
+
+
+  
+  
+
+  
+  
+  /*********************************************/
+  /* Memory                                    */
+  /*********************************************/
+  
+  /*
+  * All memory the library needs internally is obtained through mbiAlloc
+  * and given back through mbiFree.
+  *
+  * - Blocks are 64-byte aligned, so whole cache lines and vector registers
+  *   are never split at the start of a Big Int.
+  * - Block sizes are rounded up to size classes, four per power of 2, and
+  *   freed blocks are kept in a free list per class, so the temporaries of
+  *   repeated multiplications are recycled instead of allocated again.
+  * - Blocks from MBI_ALLOC_MMAP_THRESHOLD bytes on are mapped directly,
+  *   aligned to huge pages and with MADV_HUGEPAGE, or from hugetlbfs if
+  *   that is switched on and pages are reserved. Optionally, they are bound
+  *   to the NUMA node of the calling thread.
+  * - The whole layer can be replaced by an allocator hook (see below),
+  *   which is then called for every block.
+  *
+  * The settings must not change while blocks are in use.
+  */
+  
+  typedef struct {
+    void* (*reallocate)( void* context, void* p, size_t oldsize, size_t newsize );
+    void  (*release)( void* context, void* p, size_t size );
+    void* context;
+  } bigintallocator;
+  
+  /* Blocks from this size on are mapped directly */
+  #ifndef MBI_ALLOC_MMAP_THRESHOLD
+  #define MBI_ALLOC_MMAP_THRESHOLD ((size_t)1 << 21)
+  #endif
+  
+  /* Maximal number of bytes kept in the free lists */
+  #ifndef MBI_ALLOC_CACHE
+  #define MBI_ALLOC_CACHE ((size_t)1 << 28)
+  #endif
+  
+  #define MBI_ALLOC_ALIGN    64
+  #define MBI_ALLOC_MINIMUM  256
+  #define MBI_ALLOC_CLASSES  (4 * 8 * sizeof(size_t))
+  #define MBI_HUGEPAGE       ((size_t)1 << 21)
+  
+  typedef struct {
+    const bigintallocator* hook;   /* replaces the layer if not NULL */
+    size_t mmapthreshold;
+    size_t cachelimit;
+    bool hugetlb;                  /* try hugetlbfs pages first */
+    bool numa;                     /* bind mapped blocks to the local node */
+  } bigintallocconfig;
+  
+  bigintallocconfig mbiAllocConfig = { NULL, MBI_ALLOC_MMAP_THRESHOLD, MBI_ALLOC_CACHE, false, false };
+  
+  /* Header in front of every block */
+  typedef union {
+    struct {
+      void* next;
+      void* raw;
+      size_t size;
+      unsigned int sizeclass;
+      bool mapped;
+    } h;
+    unsigned char pad[MBI_ALLOC_ALIGN];
+  } bigintblock;
+  
+  struct {
+    bigintblock* lists[MBI_ALLOC_CLASSES];
+    size_t cached;
+    size_t mapped;
+    char lock;
+  } mbiAllocState;
+  
+  
+  /*
+  * Returns the size class of a block of total bytes, header included
+  * Remark: Class c > 0 covers (2^{e-1} + (q-1) 2^{e-3}, 2^{e-1} + q 2^{e-3}]
+    with e = (c-1)/4 + 9 and q = (c-1)%4 + 1, class 0 everything up to
+    MBI_ALLOC_MINIMUM.
+  */
+  unsigned int mbiAllocClass( size_t total )
+  {
+    if( total <= MBI_ALLOC_MINIMUM ) return 0;
+    unsigned int e = DIGIT_BITS - mbiDigitLeadingZeros( (bigint)( total - 1 ) );
+    size_t step = (size_t)1 << ( e - 3 );
+    size_t q = ( total - ( (size_t)1 << ( e - 1 ) ) + step - 1 ) / step;
+    return 4 * ( e - 9 ) + (unsigned int)q;
+  }
+  
+  /*
+  * Returns the number of bytes of the blocks of a size class
+  * Remark: None
+  */
+  size_t mbiAllocClassSize( unsigned int c )
+  {
+    if( c == 0 ) return MBI_ALLOC_MINIMUM;
+    unsigned int e = ( c - 1 ) / 4 + 9;
+    size_t q = ( c - 1 ) % 4 + 1;
+    return ( (size_t)1 << ( e - 1 ) ) + q * ( (size_t)1 << ( e - 3 ) );
+  }
+  
+  #ifdef MBI_ALLOC_MMAP
+  
+  /*
+  * Maps a block of size bytes
+  * Remark: size is a multiple of the page size. Returns NULL on failure.
+  */
+  void* mbiAllocMap( size_t size )
+  {
+    char* p = MAP_FAILED;
+    
+  #ifdef MAP_HUGETLB
+    if( mbiAllocConfig.hugetlb && size % MBI_HUGEPAGE == 0 )
+      p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+  #endif
+    
+    if( p == MAP_FAILED ){
+      
+      /* Map a huge page more and cut off both ends, so the block is aligned to huge pages */
+      size_t extra = size >= MBI_HUGEPAGE ? MBI_HUGEPAGE : 0;
+      char* q = mmap( NULL, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+      if( q == MAP_FAILED ) return NULL;
+      
+      size_t head = extra ? ( MBI_HUGEPAGE - (uintptr_t)q % MBI_HUGEPAGE ) % MBI_HUGEPAGE : 0;
+      if( head > 0 ) munmap( q, head );
+      if( extra - head > 0 ) munmap( q + head + size, extra - head );
+      p = q + head;
+      
+      madvise( p, size, MADV_HUGEPAGE );
+      
+    }
+    
+  #if defined(SYS_mbind) && defined(SYS_getcpu)
+    if( mbiAllocConfig.numa ){
+      unsigned int cpu, node;
+      if( syscall( SYS_getcpu, &cpu, &node, NULL ) == 0 && node < 8 * sizeof(unsigned long) ){
+        unsigned long mask = 1UL << node;
+        /* MPOL_PREFERRED: fall back to other nodes rather than fail */
+        syscall( SYS_mbind, p, size, 1, &mask, 8 * sizeof(unsigned long) + 1, 0 );
+      }
+    }
+  #endif
+    
+    return p;
+  }
+  
+  #endif
+  
+  /*
+  * Gives a block back to the system
+  * Remark: None
+  */
+  void mbiAllocRelease( bigintblock* block )
+  {
+  #ifdef MBI_ALLOC_MMAP
+    if( block->h.mapped ){
+      munmap( block->h.raw, block->h.size );
+      return;
+    }
+  #endif
+    free( block->h.raw );
+  }
+  
+  /*
+  * Allocates memory
+  * Remark: The memory is 64-byte aligned and not initialized. Returns NULL
+    if no memory could be obtained.
+  */
+  void* mbiAlloc( size_t bytes )
+  {
+    
+    if( mbiAllocConfig.hook != NULL )
+      return mbiAllocConfig.hook->reallocate( mbiAllocConfig.hook->context, NULL, 0, bytes );
+    
+    unsigned int c = mbiAllocClass( bytes + sizeof(bigintblock) );
+    assert( c < MBI_ALLOC_CLASSES );
+    
+    /* Recycle a block */
+    while( __atomic_test_and_set( &mbiAllocState.lock, __ATOMIC_ACQUIRE ) );
+    bigintblock* block = mbiAllocState.lists[c];
+    if( block != NULL ){
+      mbiAllocState.lists[c] = block->h.next;
+      mbiAllocState.cached -= block->h.size;
+    }
+    __atomic_clear( &mbiAllocState.lock, __ATOMIC_RELEASE );
+    
+    if( block != NULL ) return block + 1;
+    
+    /* Get a new one */
+    size_t size = mbiAllocClassSize( c );
+    
+  #ifdef MBI_ALLOC_MMAP
+    if( size >= mbiAllocConfig.mmapthreshold && size % 4096 == 0 ){
+      block = mbiAllocMap( size );
+      if( block != NULL ){
+        block->h.raw    = block;
+        block->h.mapped = true;
+        __atomic_fetch_add( &mbiAllocState.mapped, size, __ATOMIC_RELAXED );
+      }
+    }
+  #endif
+    
+    if( block == NULL ){
+      unsigned char* raw = malloc( size + MBI_ALLOC_ALIGN - 1 );
+      if( raw == NULL ) return NULL;
+      block = (bigintblock*)( raw + ( MBI_ALLOC_ALIGN - (uintptr_t)raw % MBI_ALLOC_ALIGN ) % MBI_ALLOC_ALIGN );
+      block->h.raw    = raw;
+      block->h.mapped = false;
+    }
+    
+    block->h.size      = size;
+    block->h.sizeclass = c;
+    return block + 1;
+  }
+  
+  /*
+  * Frees memory of mbiAlloc
+  * Remark: bytes is the size it has been allocated with. p may be NULL.
+  */
+  void mbiFree( void* p, size_t bytes )
+  {
+    
+    if( p == NULL ) return;
+    
+    if( mbiAllocConfig.hook != NULL ){
+      mbiAllocConfig.hook->release( mbiAllocConfig.hook->context, p, bytes );
+      return;
+    }
+    
+    bigintblock* block = (bigintblock*)p - 1;
+    
+    while( __atomic_test_and_set( &mbiAllocState.lock, __ATOMIC_ACQUIRE ) );
+    bool keep = mbiAllocState.cached + block->h.size <= mbiAllocConfig.cachelimit;
+    if( keep ){
+      block->h.next = mbiAllocState.lists[block->h.sizeclass];
+      mbiAllocState.lists[block->h.sizeclass] = block;
+      mbiAllocState.cached += block->h.size;
+    }
+    __atomic_clear( &mbiAllocState.lock, __ATOMIC_RELEASE );
+    
+    if( !keep ){
+      if( block->h.mapped ) __atomic_fetch_sub( &mbiAllocState.mapped, block->h.size, __ATOMIC_RELAXED );
+      mbiAllocRelease( block );
+    }
+    
+  }
+  
+  /*
+  * Changes the size of memory of mbiAlloc
+  * Remark: Works like realloc; oldsize is the size p has been allocated
+    with. The block is kept if it is large enough.
+  */
+  void* mbiRealloc( void* p, size_t oldsize, size_t newsize )
+  {
+    
+    if( mbiAllocConfig.hook != NULL )
+      return mbiAllocConfig.hook->reallocate( mbiAllocConfig.hook->context, p, oldsize, newsize );
+    
+    if( p != NULL && newsize + sizeof(bigintblock) <= ( (bigintblock*)p - 1 )->h.size )
+      return p;
+    
+    void* q = mbiAlloc( newsize );
+    if( q == NULL ) return NULL;
+    if( p != NULL ){
+      memcpy( q, p, oldsize < newsize ? oldsize : newsize );
+      mbiFree( p, oldsize );
+    }
+    return q;
+  }
+  
+  /*
+  * Gives all blocks in the free lists back to the system
+  * Remark: None
+  */
+  void mbiAllocTrim( void )
+  {
+    for( unsigned int c = 0; c < MBI_ALLOC_CLASSES; c++ )
+    {
+      while( __atomic_test_and_set( &mbiAllocState.lock, __ATOMIC_ACQUIRE ) );
+      bigintblock* block = mbiAllocState.lists[c];
+      mbiAllocState.lists[c] = NULL;
+      
+      size_t bytes = 0;
+      for( bigintblock* b = block; b != NULL; b = b->h.next ) bytes += b->h.size;
+      
+      __atomic_fetch_sub( &mbiAllocState.cached, bytes, __ATOMIC_RELAXED );
+      __atomic_clear( &mbiAllocState.lock, __ATOMIC_RELEASE );
+      
+      while( block != NULL )
+      {
+        bigintblock* next = block->h.next;
+        if( block->h.mapped ) __atomic_fetch_sub( &mbiAllocState.mapped, block->h.size, __ATOMIC_RELAXED );
+        mbiAllocRelease( block );
+        block = next;
+      }
+    }
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Other multiplication operations           */
+  /*********************************************/
+
+
+
+  /*
+  * Multiplies a Big Int with a single digit
+  * Remark: dest and src point to n digits, dest receives the lower n
+    digits of src*limb and the upper digit is returned. dest may equal src.
+  */
+  bigint mbiMulLimb( bigintlength n, bigint* dest, const bigint* src, bigint limb )
+  {
+    bigint carry = 0;
+    for( bigintlength i = 0; i < n; i++ )
+    {
+      bigint hi, lo;
+      lo = mbiMulDigits( src[i], limb, &hi );
+      lo += carry;
+      hi += ( lo < carry );
+      dest[i] = lo;
+      carry = hi;
+    }
+    return carry;
+  }
+  
+  /*
+  * Divides a Big Int by a single digit with its reciprocal
+  * Remark: Like DivRemLimb. The remainder is kept shifted like r->norm,
+    so every digit of src is divided as (rem B + src[i]) 2^shift by
+    r->norm, which has the same quotient.
+  */
+  bigint mbiDivRemLimbPre( bigintlength n, bigint* dest, const bigint* src, const bigintreciprocal* r )
+  {
+    const unsigned int s = r->shift;
+    bigint rem = 0;
+    for( bigintlength i = n; i > 0; i-- )
+    {
+      bigint u = src[i-1];
+      /* the double shift is zero for s = 0 */
+      dest[i-1] = mbiDivDigitsPre( rem | ( ( u >> 1 ) >> ( DIGIT_BITS - 1 - s ) ), u << s, r, &rem );
+    }
+    return rem >> s;
+  }
+  
+  /*
+  * Divides a Big Int by a single digit
+  * Remark: dest and src point to n digits, dest receives the quotient of
+    src by d and the remainder is returned. dest may equal src. d must not
+    be zero. The one division for the reciprocal replaces one per digit.
+  */
+  bigint mbiDivRemLimb( bigintlength n, bigint* dest, const bigint* src, bigint d )
+  {
+    bigintreciprocal r;
+    mbiReciprocalInit( &r, d );
+    return mbiDivRemLimbPre( n, dest, src, &r );
+  }
+  
+  /*
+  * Remainders of a Big Int by several digits in one pass
+  * Remark: src points to n digits, rems receives the remainders of src by
+    the count divisors. Each digit of src is loaded once, and the
+    divisions by the different divisors do not depend on each other, so
+    they overlap in the pipeline, e.g. for trial division by small primes.
+  */
+  void mbiRemLimbs( bigintlength n, const bigint* src, unsigned int count, const bigintreciprocal* divisors, bigint* rems )
+  {
+    for( unsigned int j = 0; j < count; j++ ) rems[j] = 0;
+    for( bigintlength i = n; i > 0; i-- )
+    {
+      bigint u = src[i-1];
+      for( unsigned int j = 0; j < count; j++ )
+      {
+        const unsigned int s = divisors[j].shift;
+        mbiDivDigitsPre( rems[j] | ( ( u >> 1 ) >> ( DIGIT_BITS - 1 - s ) ), u << s, &divisors[j], &rems[j] );
+      }
+    }
+    for( unsigned int j = 0; j < count; j++ ) rems[j] >>= divisors[j].shift;
+  }
+  
+
+  /*
+  * Adds the multiple of a Big Int with a single digit
+  * Remark: dest and src point to n digits, src*limb is added onto dest
+    and the carry digit is returned. This is one row of the school method.
+  */
+  bigint mbiAddMulLimb( bigintlength n, bigint* dest, const bigint* src, bigint limb )
+  {
+    bigint carry = 0;
+    for( bigintlength i = 0; i < n; i++ )
+    {
+      bigint hi, lo;
+      lo = mbiMulDigits( src[i], limb, &hi );
+      lo += carry;
+      hi += ( lo < carry );
+      lo += dest[i];
+      hi += ( lo < dest[i] );
+      dest[i] = lo;
+      carry = hi;
+    }
+    return carry;
+  }
+  
+  /*
+  * Subtracts the multiple of a Big Int with a single digit
+  * Remark: dest and src point to n digits, src*limb is subtracted from
+    dest and the borrow digit is returned, i.e. the value that still has to
+    be subtracted at dest[n]. The row of a school division.
+  */
+  bigint mbiSubMulLimb( bigintlength n, bigint* dest, const bigint* src, bigint limb )
+  {
+    bigint borrow = 0;
+    for( bigintlength i = 0; i < n; i++ )
+    {
+      bigint hi, lo;
+      lo = mbiMulDigits( src[i], limb, &hi );
+      lo += borrow;
+      hi += ( lo < borrow );
+      hi += ( dest[i] < lo );
+      dest[i] -= lo;
+      borrow = hi;
+    }
+    return borrow;
+  }
+  
+  /*
+  * Adds the multiple of a Big Int with two digits
+  * Remark: dest and src point to n digits, src*(l0 + l1*B) is added onto
+    dest. The two carry digits are returned, the lower one as the return
+    value and the upper one in hi. These are two rows of the school method
+    in one pass: each digit of dest is loaded and stored once, and the
+    carries of both rows stay in registers.
+  */
+  bigint mbiAddMul2Limbs( bigintlength n, bigint* dest, const bigint* src, bigint l0, bigint l1, bigint* hi )
+  {
+    bigint c0 = 0, c1 = 0, prev = 0;
+    for( bigintlength i = 0; i < n; i++ )
+    {
+      bigint h, lo, d;
+      
+      /* first row, digit i */
+      lo = mbiMulDigits( src[i], l0, &h );
+      lo += c0;
+      h  += ( lo < c0 );
+      d   = dest[i] + lo;
+      h  += ( d < lo );
+      c0  = h;
+      
+      /* second row, digit i-1 */
+      lo = mbiMulDigits( prev, l1, &h );
+      lo += c1;
+      h  += ( lo < c1 );
+      d  += lo;
+      h  += ( d < lo );
+      c1  = h;
+      
+      dest[i] = d;
+      prev = src[i];
+    }
+    
+    /* the last digit of the second row and both carries */
+    bigint h, lo;
+    lo = mbiMulDigits( prev, l1, &h );
+    lo += c1;
+    h  += ( lo < c1 );
+    lo += c0;
+    h  += ( lo < c0 );
+    *hi = h;
+    return lo;
+  }
+  
+  
+  /*
+  * Multiplies two Big ints of arbitrary lengths, school method basecase
+  * Remark: a has n1 and b has n2 digits, p points to n1+n2 digits the
+    result is saved in. p must not overlap with a or b. The product is
+    built from AddMul2Limbs rows, i.e. two digits of b at a time. a is
+    processed in tiles of MBI_BASECASE_TILE digits, so the tile of a and
+    the window of p it is added to stay in the L1 cache for all rows.
+  */
+  #ifndef MBI_BASECASE_TILE
+  #define MBI_BASECASE_TILE 256
+  #endif
+  
+  void mbiMulBasecase( bigint* p, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    
+    mbiSetZero( n1+n2, p );
+    
+    for( bigintlength ia = 0; ia < n1; ia += MBI_BASECASE_TILE )
+    {
+      bigintlength t = n1 - ia < MBI_BASECASE_TILE ? n1 - ia : MBI_BASECASE_TILE;
+      
+      for( bigintlength j = 0; j < n2; j += 2 )
+      {
+        bigint *q = p + ia + j;
+        bigintlength rest = n1 + n2 - ia - j - t;
+        bigint c[2];
+        
+        if( j + 1 < n2 ){
+          c[0] = mbiAddMul2Limbs( t, q, a + ia, b[j], b[j+1], &c[1] );
+        }else{
+          c[0] = mbiAddMulLimb( t, q, a + ia, b[j] );
+          c[1] = 0;
+        }
+        
+        /* add the carries onto the rest of the product */
+        bool carry = false;
+        if( rest >= 2 ){
+          mbiAdd( 2, q + t, c, &carry );
+          if( carry ){
+            carry = false;
+            mbiInc( rest - 2, q + t + 2, &carry );
+          }
+        }else{
+          assert( rest == 1 && c[1] == 0 );
+          q[t] += c[0];
+        }
+      }
+    }
+    
+  }
+  
+  
+  /*
+  * Multiplies to Big ints according to basic school method
+  * Remark: Bigints a and b must have the same length, which must be of
+    form 2^{k}. p points to a Bigint of double size - 2^{k+1} - the
+    result is saved in.
+  */
+  void mbiNaivMultiplication( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  {
+    
+    bigintlength i, j;
+    bigintlength length = 1 << k;
+    
+    mbiSetZero( length*2, p );
+    
+    /* Collect the carries and add them later */
+    bigint* overflows = mbiAlloc( sizeof(bigint)*length*2 );
     assert( overflows != NULL );
     mbiSetZero( length*2, overflows );
     
-    /* main part */
-    for( i = 0; i < length; i++ )
+    /* main part */
+    for( i = 0; i < length; i++ )
+    {
+      for( j = 0; j < length; j++ ){
+        
+        bigint w[2];
+        bool carry  = false;
+        
+        w[0] = mbiMulDigits( a[i], b[j], &w[1] );
+        
+        /*
+        * If the rest of the code works properly
+        * we can use the following line
+        * without fear of memory corruption
+        */
+        mbiAdd( 2, p+(i+j), w, &carry );
+        if(carry) overflows[i+j+2]++;
+        
+      }
+    }
+    
+    /* evaluate the carries */
+    bool carry = false;
+    mbiAdd( 2*length, p, overflows, &carry );
+    assert(!carry);
+    
+    mbiFree( overflows, sizeof(bigint)*length*2 );
+    
+  }
+ 
+ 
+  
+  /*
+  * Multiplies two Big ints of arbitrary lengths according to school method
+  * Remark: a has n1 and b has n2 digits, p points to n1+n2 digits the
+    result is saved in. p must not overlap with a or b. Works row by row,
+    each row adds a*b[i] onto the product and carries a whole digit.
+  */
+  void mbiNaivMultiplication2( bigint* p, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    
+    bigintlength i, j;
+    
+    mbiSetZero( n1+n2, p );
+    
+    for( i = 0; i < n2; i++ )
+    {
+      bigint carry = 0;
+      for( j = 0; j < n1; j++ ){
+        bigint hi, lo;
+        lo = mbiMulDigits( a[j], b[i], &hi );
+        lo += carry;
+        hi += ( lo < carry );
+        p[i+j] += lo;
+        hi += ( p[i+j] < lo );
+        carry = hi;
+      }
+      p[i+n1] = carry;
+    }
+    
+  }
+
+ 
+  /*
+  * Multiplies to Big ints of size <= 128 according to basic school method
+  * Remarks: Works like a NaivMultiplication, but it has been optimized
+    for and is restricted to the case of k <= 7. Could be even more sped-up
+    by using uchars for the overflows
+  */
+  void mbiNaivMultiplicationRestricted( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  {
+    
+    assert( k <= 7 );
+    bigintlength i, j;
+    bigintlength length = 1 << k;
+    assert( length <= 128 );
+    
+    mbiSetZero( length*2, p );
+    
+    /* Collect the carries and add them later */
+    bigint overflows[256];
+    mbiSetZero( length*2, overflows );
+    
+    /* main part */
+    for( i = 0; i < length; i++ )
+    {
+      for( j = 0; j < length; j++ ){
+        
+        bigint w[2];
+        bool carry  = false;
+        
+        w[0] = mbiMulDigits( a[i], b[j], &w[1] );
+        
+        /*
+        * If the rest of the code works properly
+        * we can use the following line
+        * without fear of memory corruption
+        */
+        mbiAdd( 2, p+(i+j), w, &carry );
+        if(carry) overflows[i+j+2]++;
+        
+      }
+    }
+    
+    /* evaluate the carries */
+    bool carry = false;
+    mbiAdd( 2*length, p, overflows, &carry );
+    assert(!carry);
+    
+  }
+  
+  
+  
+ 
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  /*******************************************************/
+  /* Karatsuba-Ofmann-Algorithm                          */
+  /*******************************************************/
+  
+  
+  /*
+  * Factors of at most 2^MBI_BASECASE_EXPONENT digits are multiplied by
+  * the school method basecase.
+  */
+  #ifndef MBI_BASECASE_EXPONENT
+  #define MBI_BASECASE_EXPONENT 6
+  #endif
+  
+  /*
+  * Multiplies to Big ints according to Karatsuba-Ofmann, with prepared differences
+  * Remark: Works like Multiply. If bnode is not NULL, it points to the
+    differences of the halves of b which have been precomputed by a Prepare for
+    depth more levels (see below), and those are used instead of being
+    computed again. scratch points to MultiplyScratchSize(k) digits.
+  */
+  void mbiMultiplyCore( bigintexpo k, bigint* p, const bigint* a, const bigint* b, const bigint* bnode, bigintexpo depth, bigint* scratch );
+  
+  /*
+  * Scratch memory of up to this many digits is taken from the stack
+  */
+  #ifndef MBI_STACK_DIGITS
+  #define MBI_STACK_DIGITS 4096
+  #endif
+  
+  /*
+  * Returns the number of digits of scratch memory for a product of 2^k digits
+  * Remark: Each level above the basecase needs 2^k digits, less than
+    2^{k+1} in total.
+  */
+  bigintlength mbiMultiplyScratchSize( bigintexpo k )
+  {
+    bigintlength s = 0;
+    for( ; k > MBI_BASECASE_EXPONENT; k-- ) s += (bigintlength)1 << k;
+    return s;
+  }
+  
+  /*
+  * Multiplies according to MultiplyCore with scratch memory of its own
+  * Remark: Small scratch memory is on the stack, larger is obtained from
+    mbiAlloc, i.e. huge pages for large k.
+  */
+  void mbiMultiplyCoreAlloc( bigintexpo k, bigint* p, const bigint* a, const bigint* b, const bigint* bnode, bigintexpo depth )
+  {
+    bigintlength s = mbiMultiplyScratchSize( k );
+    if( s <= MBI_STACK_DIGITS ){
+      bigint heap[ MBI_STACK_DIGITS ];
+      mbiMultiplyCore( k, p, a, b, bnode, depth, heap );
+    }else{
+      bigint* heap = mbiAlloc( sizeof(bigint) * s );
+      assert( heap != NULL );
+      mbiMultiplyCore( k, p, a, b, bnode, depth, heap );
+      mbiFree( heap, sizeof(bigint) * s );
+    }
+  }
+  
+  /*
+  * Multiplies to Big ints according to Karatsuba-Ofmann
+  * Bemerkung: Bigints a and b must have the same length, which must be of
+    form 2^{k}. p points to a Bigint of double size - 2^{k+1} - the result
+    is saved in.
+  */
+  void mbiMultiply( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  {
+    mbiMultiplyCoreAlloc( k, p, a, b, NULL, 0 );
+  }
+  
+  /*
+  * Multiplies to Big ints according to Karatsuba-Ofmann, with given scratch memory
+  * Remark: Works like Multiply, but the temporaries of all levels are taken
+    from scratch, which points to MultiplyScratchSize(k) digits, instead of
+    the stack.
+  */
+  void mbiMultiplyScratch( bigintexpo k, bigint* p, const bigint* a, const bigint* b, bigint* scratch )
+  {
+    mbiMultiplyCore( k, p, a, b, NULL, 0, scratch );
+  }
+  
+  /*
+  * Returns the number of digits of the prepared differences of a factor of
+  * 2^k digits for depth levels
+  * Remark: Per level, a node holds the sign and the difference |bl-bh|,
+    followed by the nodes of |bl-bh|, bl and bh for the next level.
+  */
+  bigintlength mbiPreparedTreeSize( bigintexpo k, bigintexpo depth )
+  {
+    if( depth == 0 || k <= MBI_BASECASE_EXPONENT ) return 0;
+    return 1 + ((bigintlength)1 << (k-1)) + 3 * mbiPreparedTreeSize( k-1, depth-1 );
+  }
+  
+  void mbiMultiplyCore( bigintexpo k, bigint* p, const bigint* a, const bigint* b, const bigint* bnode, bigintexpo depth, bigint* scratch )
+  {
+    
+    /* calculate length of a and b */
+    bigintlength length = 1 << k;
+    
+    /*
+    * Zero factors and factors with a single digit need no recursion.
+    * The checks scan from the top, so they stop at once for dense numbers.
+    */
+    if( mbiIsZero( length, a ) || mbiIsZero( length, b ) ){
+      mbiSetZero( 2*length, p );
+      return;
+    }
+    if( mbiIsZero( length-1, a+1 ) ){
+      p[length] = mbiMulLimb( length, p, b, a[0] );
+      mbiSetZero( length-1, p+length+1 );
+      return;
+    }
+    if( mbiIsZero( length-1, b+1 ) ){
+      p[length] = mbiMulLimb( length, p, a, b[0] );
+      mbiSetZero( length-1, p+length+1 );
+      return;
+    }
+    
+    /*
+    * if we are below the threshold, switch to school method
+    * Die Wechselgrenze wurde empirisch ueber den Daumen geschaetzt
+    */  
+    if( k <= MBI_BASECASE_EXPONENT ){
+      mbiMulBasecase( p, length, a, length, b );
+      return;
+    }
+    
+    /***************************************/
+    /* Declaration and initialization      */
+    /***************************************/
+    
+    /* pointers to the low- and high-parts of the factors */
+    const bigint *al,*ah,*bl,*bh;
+    al = a;
+    bl = b;
+    ah = a + length/2;
+    bh = b + length/2;
+    
+    /* Pointers to target memory */
+    bigint *u1, *u2, *u3, *u4;
+    u1 = p;
+    u2 = p + length/2;
+    u3 = p + length;
+    u4 = p + length + length/2;
+    
+    /* Pointer to heap, the rest of the scratch memory is for the recursion */
+    bigint *heap = scratch;
+    scratch += length;
+    
+    assert( heap != NULL );
+    
+    /* Pointer to products ahbh and albl */
+    bigint *ahbh = u3;
+    bigint *albl = u1;
+    
+    /* Prepared differences of b and its nodes for the next level */
+    const bigint *nodes = NULL, *nodel = NULL, *nodeh = NULL;
+    if( bnode != NULL && depth > 0 ){
+      bigintlength c = mbiPreparedTreeSize( k-1, depth-1 );
+      if( c > 0 ){
+        nodes = bnode + 1 + length/2;
+        nodel = nodes + c;
+        nodeh = nodel + c;
+      }
+    }else{
+      bnode = NULL;
+    }
+    
+    
+    /******************************/
+    /* Zero halves                */
+    /******************************/
+    
+    /*
+    * If one of the halves is zero, one or two of the three products
+    * vanish. This happens at every level for padded factors, e.g. from
+    * Multiplikation, and for numbers with large zero blocks.
+    */
+    
+    bool ahz = mbiIsZero( length/2, ah );
+    bool bhz = mbiIsZero( length/2, bh );
+    bool alz = mbiIsZero( length/2, al );
+    bool blz = mbiIsZero( length/2, bl );
+    
+    if( ahz && bhz ){
+      mbiMultiplyCore( k-1, albl, al, bl, nodel, depth-1, scratch );
+      mbiSetZero( length, u3 );
+      return;
+    }
+    
+    if( alz && blz ){
+      mbiSetZero( length, u1 );
+      mbiMultiplyCore( k-1, ahbh, ah, bh, nodeh, depth-1, scratch );
+      return;
+    }
+    
+    if( ahz || bhz || alz || blz ){
+      
+      /* One of albl and ahbh vanishes, and one cross product remains */
+      if( ahz || bhz ){
+        mbiMultiplyCore( k-1, albl, al, bl, nodel, depth-1, scratch );
+        mbiSetZero( length, u3 );
+      }else{
+        mbiSetZero( length, u1 );
+        mbiMultiplyCore( k-1, ahbh, ah, bh, nodeh, depth-1, scratch );
+      }
+      
+      if( ahz || blz )
+        mbiMultiplyCore( k-1, heap, al, bh, nodeh, depth-1, scratch );
+      else
+        mbiMultiplyCore( k-1, heap, ah, bl, nodel, depth-1, scratch );
+      
+      bool carryz = false;
+      mbiAdd( length, u2, heap, &carryz );
+      if( carryz ){
+        carryz = false;
+        mbiInc( length/2, u4, &carryz );
+      }
+      
+      return;
+    }
+    
+    
+    /******************************/
+    /* Calculations               */
+    /******************************/
+    
+    /*
+    * Subtractive form: the middle part albl + ahbh - (al - ah)(bl - bh)
+    * is formed from the absolute differences, which fit into length/2
+    * digits. Their signs decide whether m = |al - ah||bl - bh| is added
+    * or subtracted, so no carries of sums have to be fixed up.
+    */
+    
+    /* Calculate the two differences, the one of b may be prepared */
+    const bigint *da = u4, *db = u1;
+    bool nega = mbiCopyAbsSub( length/2, u4, al, length/2, ah );
+    bool negb;
+    if( bnode != NULL ){
+      negb = ( bnode[0] != 0 );
+      db = bnode + 1;
+    }else{
+      negb = mbiCopyAbsSub( length/2, u1, bl, length/2, bh );
+    }
+    
+    /* First recursion, m goes to the heap */
+    mbiMultiplyCore( k-1, heap, da, db, nodes, depth-1, scratch );
+    
+    /*
+    * Now the differences are not needed anymore
+    * We write al*bl and ah*bh directly into the target memory
+    */
+    
+    /* Calculate albl */
+    mbiMultiplyCore( k-1, albl, al, bl, nodel, depth-1, scratch );
+    
+    /* Calculate ahbh */
+    mbiMultiplyCore( k-1, ahbh, ah, bh, nodeh, depth-1, scratch );
+    
+    /*
+    * With albl = x0 + x1 B^h and ahbh = y0 + y1 B^h, h = length/2, the
+    * middle part adds x0 + y0 at u2 and x1 + y1 at u3. Both need
+    * t = x1 + y0, so u3 = t + y1 and u2 = t + x0. The carries are
+    * counted for u3 and u4 and added at the end.
+    */
+    
+    bool carryt = false;
+    mbiAdd( length/2, u3, u2, &carryt );
+    int overflow3 = carryt;
+    int overflow4 = carryt;
+    
+    carryt = false;
+    mbiCopyAdd( length/2, u2, u3, u1, &carryt );
+    overflow3 += carryt;
+    
+    carryt = false;
+    mbiAdd( length/2, u3, u4, &carryt );
+    overflow4 += carryt;
+    
+    /* Add or sub m, depending on the sign of (al - ah)(bl - bh) */
+    bool carryq = false;
+    if( nega != negb ){
+      mbiAdd( length, u2, heap, &carryq );
+      overflow4 += carryq;
+    }else{
+      mbiSub( length, u2, heap, &carryq );
+      overflow4 -= carryq;
+    }
+    
+    /*
+    * Evaluate the overflows. The product fits into the target memory,
+    * so a borrow may run over its end while a carry is still pending.
+    */
+    for( ; overflow3 > 0; overflow3-- ){
+      carryq = false;
+      mbiInc( length, u3, &carryq );
+    }
+    for( ; overflow4 > 0; overflow4-- ){
+      carryq = false;
+      mbiInc( length/2, u4, &carryq );
+    }
+    if( overflow4 < 0 ){
+      carryq = false;
+      mbiDec( length/2, u4, &carryq );
+    }
+    
+    /**********************************/
+    /* Result is in the target memory */
+    /**********************************/
+    
+    
+    
+    /*{
+      bigint* test = malloc( length*2 * sizeof(bigint) );
+      NaivMultiplication( k, test, a, b );
+      if( Compare( length*2, test, p ) ){
+        printf( "Hauptrechnung: %d\n", length );
+        OutputBigint( length, a );
+        OutputBigint( length, b );
+        OutputBigint( length*2, p );
+        OutputBigint( length*2, test );
+        assert(false);
+      }
+      free(test);
+    }*/
+
+  }
+    
+    
+    
+  
+  
+  
+      
+      
+  
+  
+  
+  
+  
+  
+  
+  
+  
+  /*******************************************************/
+  /* Karatsuba-Ofmann for arbitrary lengths              */
+  /*******************************************************/
+  
+  /*
+  * Returns the number of digits of scratch memory MultiplyNScratch needs
+  * Remark: Each level keeps the middle product of 2h digits, where
+    h = n - n/2 is the size of the larger halves, so it's about 2n in total.
+  */
+  bigintlength mbiMultiplyNScratchSize( bigintlength n )
+  {
+    bigintlength s = 0;
+    while( n > ((bigintlength)1 << MBI_BASECASE_EXPONENT) )
+    {
+      bigintlength h = n - n/2;
+      s += 2*h;
+      n = h;
+    }
+    return s;
+  }
+  
+  /*
+  * Multiplies two Big ints of the same, arbitrary length according to Karatsuba-Ofmann
+  * Remark: a and b have n digits, p points to 2n digits the result is
+    saved in and must not overlap with a or b. scratch points to at least
+    MultiplyNScratchSize(n) digits. The factors are split into a lower
+    part of n/2 and an upper part of h = n - n/2 digits; the absolute
+    differences of the halves are kept in p until albl and ahbh are written
+    there.
+  */
+  void mbiMultiplyNScratch( bigintlength n, bigint* p, const bigint* a, const bigint* b, bigint* scratch )
+  {
+    
+    if( n <= ((bigintlength)1 << MBI_BASECASE_EXPONENT) ){
+      mbiMulBasecase( p, n, a, n, b );
+      return;
+    }
+    
+    bigintlength l = n/2;
+    bigintlength h = n - l;
+    
+    const bigint *al = a, *ah = a + l;
+    const bigint *bl = b, *bh = b + l;
+    
+    bigint *da = p, *db = p + h;
+    bigint *m  = scratch;
+    
+    /* Calculate the two differences, the upper halves may have one digit more */
+    bool nega = mbiCopyAbsSub( l, da, al, h, ah );
+    bool negb = mbiCopyAbsSub( l, db, bl, h, bh );
+    
+    /* Middle product |al - ah||bl - bh|, 2h digits */
+    mbiMultiplyNScratch( h, m, da, db, scratch + 2*h );
+    
+    /* albl and ahbh go straight to the target memory */
+    mbiMultiplyNScratch( l, p, al, bl, scratch + 2*h );
+    mbiMultiplyNScratch( h, p + 2*l, ah, bh, scratch + 2*h );
+    
+    /*
+    * The middle part albl + ahbh -+ m may have 2h+1 digits, its top digit
+    * is counted in overflow. If m is subtracted, m - albl - ahbh is formed
+    * instead and subtracted from p.
+    */
+    bool add = ( nega != negb );
+    int overflow = 0;
+    bool carry = false;
+    
+    if( add ) mbiAdd( 2*l, m, p, &carry );
+    else mbiSub( 2*l, m, p, &carry );
+    if( carry && h > l ){
+      if( add ) mbiInc( 2*h - 2*l, m + 2*l, &carry );
+      else mbiDec( 2*h - 2*l, m + 2*l, &carry );
+    }
+    overflow += carry;
+    
+    carry = false;
+    if( add ) mbiAdd( 2*h, m, p + 2*l, &carry );
+    else mbiSub( 2*h, m, p + 2*l, &carry );
+    overflow += carry;
+    
+    /* Add or sub it at the right place, p has l + 2h digits above position l */
+    carry = false;
+    if( add ){
+      mbiAdd( 2*h, p + l, m, &carry );
+      overflow += carry;
+    }else{
+      mbiSub( 2*h, p + l, m, &carry );
+      overflow -= carry;
+    }
+    
+    for( ; overflow > 0; overflow-- ){
+      carry = false;
+      mbiInc( l, p + l + 2*h, &carry );
+    }
+    if( overflow < 0 ){
+      carry = false;
+      mbiDec( l, p + l + 2*h, &carry );
+    }
+    
+  }
+  
+  /*
+  * Multiplies two Big ints of the same, arbitrary length
+  * Remark: a and b have n digits, p points to 2n digits the result is
+    saved in and must not overlap with a or b. Allocates the scratch memory
+    of MultiplyNScratch.
+  */
+  void mbiMultiplyN( bigintlength n, bigint* p, const bigint* a, const bigint* b )
+  {
+    bigintlength s = mbiMultiplyNScratchSize( n );
+    bigint* scratch = NULL;
+    if( s > 0 ){
+      scratch = mbiAlloc( sizeof(bigint) * s );
+      assert( scratch != NULL );
+    }
+    mbiMultiplyNScratch( n, p, a, b, scratch );
+    mbiFree( scratch, sizeof(bigint) * s );
+  }
+  
+  
+  
+  
+  /*******************************************************/
+  /* Squaring                                            */
+  /*******************************************************/
+  
+  /*
+  * Squares a Big Int according to school method
+  * Remark: a has n digits, p points to 2n digits the result is saved in
+    and must not overlap with a. Every product a_i a_j with i < j is
+    computed once and doubled, so it takes about half of the digit
+    products of MulBasecase. Like there, the rows are done two at a time
+    by AddMul2Limbs: rows i and i+1 share a_{i+2}, ..., a_{n-1}, only the
+    product a_i a_{i+1} is left over.
+  */
+  void mbiSqrBasecase( bigint* p, bigintlength n, const bigint* a )
+  {
+    
+    mbiSetZero( 2*n, p );
+    
+    /* Products below the diagonal */
+    for( bigintlength i = 0; i + 1 < n; i += 2 )
+    {
+      bigint w[2];
+      bool carry = false;
+      
+      w[0] = mbiMulDigits( a[i], a[i+1], &w[1] );
+      mbiAdd( 2, p + 2*i+1, w, &carry );
+      if( carry ){
+        carry = false;
+        mbiInc( 2*n - 2*i - 3, p + 2*i+3, &carry );
+      }
+      
+      bigintlength t = n - i - 2;
+      if( t == 0 ) continue;
+      
+      /* a_{i+2..n-1} a_i at 2i+2 and a_{i+2..n-1} a_{i+1} at 2i+3, carries at n+i */
+      w[0] = mbiAddMul2Limbs( t, p + 2*i+2, a + i+2, a[i], a[i+1], &w[1] );
+      carry = false;
+      mbiAdd( 2, p + n+i, w, &carry );
+      if( carry && n - i > 2 ){
+        carry = false;
+        mbiInc( n - i - 2, p + n+i+2, &carry );
+      }
+    }
+    
+    if( n > 1 ){
+      bigint out = mbiFunnelLeftShift( 2*n, p, p, 1 );
+      assert( out == 0 );
+      (void)out;
+    }
+    
+    /* Add the squares on the diagonal */
+    bool carry = false;
+    for( bigintlength i = 0; i < n; i++ )
+    {
+      bigint w[2];
+      w[0] = mbiMulDigits( a[i], a[i], &w[1] );
+      mbiAdd( 2, p + 2*i, w, &carry );
+    }
+    assert( !carry );
+    
+  }
+  
+  /*
+  * Squares of at most this many digits are computed by the school method
+  */
+  #ifndef MBI_SQUARE_THRESHOLD
+  #define MBI_SQUARE_THRESHOLD 96
+  #endif
+  
+  /*
+  * Returns the number of digits of scratch memory SquareNScratch needs
+  * Remark: Each level keeps the middle square of 2h+1 digits.
+  */
+  bigintlength mbiSquareNScratchSize( bigintlength n )
+  {
+    bigintlength s = 0;
+    while( n > MBI_SQUARE_THRESHOLD )
+    {
+      bigintlength h = n - n/2;
+      s += 2*h + 1;
+      n = h;
+    }
+    return s;
+  }
+  
+  /*
+  * Squares a Big Int of arbitrary length according to Karatsuba-Ofmann
+  * Remark: a has n digits, p points to 2n digits the result is saved in
+    and must not overlap with a. scratch points to at least
+    SquareNScratchSize(n) digits. With a split into al of l = n/2 and ah
+    of h = n - l digits, the middle term is al^2 + ah^2 - (ah - al)^2, so
+    all three products are squares again and the difference needs no
+    carry digit.
+  */
+  void mbiSquareNScratch( bigintlength n, bigint* p, const bigint* a, bigint* scratch )
+  {
+    
+    if( n <= MBI_SQUARE_THRESHOLD ){
+      mbiSqrBasecase( p, n, a );
+      return;
+    }
+    
+    bigintlength l = n/2;
+    bigintlength h = n - l;
+    
+    const bigint *al = a, *ah = a + l;
+    bigint *d = p;
+    bigint *m = scratch;
+    
+    /* |ah - al| with h digits, kept in p until the squares are written there */
+    bool carry = false;
+    if( ( h == l || ah[l] == 0 ) && mbiCompare( l, ah, al ) < 0 ){
+      mbiCopySub( l, d, al, ah, &carry );
+      if( h > l ) d[l] = 0;
+    }else{
+      mbiCopySub( l, d, ah, al, &carry );
+      if( h > l ) d[l] = ah[l] - carry;
+    }
+    
+    mbiSquareNScratch( h, m, d, scratch + 2*h + 1 );
+    m[2*h] = 0;
+    
+    mbiSquareNScratch( l, p, al, scratch + 2*h + 1 );
+    mbiSquareNScratch( h, p + 2*l, ah, scratch + 2*h + 1 );
+    
+    /* m = al^2 + ah^2 - m, modulo B^{2h+1} the result fits into */
+    mbiNot( 2*h + 1, m, m );
+    carry = false;
+    mbiInc( 2*h + 1, m, &carry );
+    carry = false;
+    mbiAdd( 2*l, m, p, &carry );
+    if( carry ){
+      carry = false;
+      mbiInc( 2*h + 1 - 2*l, m + 2*l, &carry );
+    }
+    carry = false;
+    mbiAdd( 2*h, m, p + 2*l, &carry );
+    m[2*h] += carry;
+    
+    /* Add it at the right place, p has l + 2h digits above position l */
+    carry = false;
+    mbiAdd( 2*h + 1, p + l, m, &carry );
+    if( carry && l > 1 ){
+      carry = false;
+      mbiInc( l - 1, p + 2*h + 1 + l, &carry );
+    }
+    
+  }
+  
+  /*
+  * Squares a Big Int of arbitrary length
+  * Remark: a has n digits, p points to 2n digits the result is saved in
+    and must not overlap with a. Allocates the scratch memory of
+    SquareNScratch.
+  */
+  void mbiSquareN( bigintlength n, bigint* p, const bigint* a )
+  {
+    bigintlength s = mbiSquareNScratchSize( n );
+    bigint* scratch = NULL;
+    if( s > 0 ){
+      scratch = mbiAlloc( sizeof(bigint) * s );
+      assert( scratch != NULL );
+    }
+    mbiSquareNScratch( n, p, a, scratch );
+    mbiFree( scratch, sizeof(bigint) * s );
+  }
+  
+  
+  
+  
+  /*******************************************************/
+  /* Short products                                      */
+  /*******************************************************/
+  
+  /*
+  * A short product computes only the lower or only the upper half of the
+  * 2n-digit product of two n-digit factors. Both use the scheme of Mulders:
+  * a full product of k digits via MultiplyN, plus two short products of
+  * the remaining n-k digits for the cross terms. The Karatsuba cost
+  * 3^(log2 n) makes k = 0.7 n about optimal; the short product then costs
+  * about 0.8 of a full product. Small sizes use a school method which only
+  * computes the needed triangle of digit products.
+  */
+  
+  #ifndef MBI_SHORT_THRESHOLD
+  #define MBI_SHORT_THRESHOLD 64
+  #endif
+  
+  /*
+  * Returns the size of the full product in a Mulders split of n digits
+  * Remark: None
+  */
+  bigintlength mbiMuldersSplit( bigintlength n )
+  {
+    return ( 7 * n + 9 ) / 10;
+  }
+  
+  /*
+  * Returns the number of digits of scratch memory the short products need
+  * Remark: None
+  */
+  bigintlength mbiShortScratchSize( bigintlength n )
+  {
+    if( n < MBI_SHORT_THRESHOLD ) return 0;
+    bigintlength k = mbiMuldersSplit( n );
+    bigintlength s1 = mbiMultiplyNScratchSize( k );
+    bigintlength s2 = mbiShortScratchSize( n - k );
+    return s1 > s2 ? s1 : s2;
+  }
+  
+  
+  /*
+  * Computes the lower half of a product, school method
+  * Remark: a and b have n digits, p receives the lower n digits of a*b and
+    must not overlap with a or b. Pairs of rows are added with AddMul2Limbs,
+    where each row is one digit shorter than the one before.
+  */
+  void mbiMulLoBasecase( bigintlength n, bigint* p, const bigint* a, const bigint* b )
+  {
+    if( n == 0 ) return;
+    
+    mbiMulLimb( n, p, a, b[0] );
+    
+    bigintlength i = 1;
+    for( ; i + 1 < n; i += 2 )
+    {
+      /* rows i and i+1 on p[i..n-1), the last digit of row i by hand */
+      bigint hi, c;
+      c = mbiAddMul2Limbs( n-i-1, p+i, a, b[i], b[i+1], &hi );
+      p[n-1] += c + a[n-1-i] * b[i];
+    }
+    if( i < n )
+      p[n-1] += a[0] * b[n-1];
+  }
+  
+  /*
+  * Computes the lower half of a product
+  * Remark: a and b have n digits, p points to 2n digits and receives the
+    lower n digits of a*b in p[0..n), p[n..2n) is used as temporary memory.
+    p must not overlap with a or b, scratch has ShortScratchSize(n) digits.
+  */
+  void mbiMulLoScratch( bigintlength n, bigint* p, const bigint* a, const bigint* b, bigint* scratch )
+  {
+    
+    if( n < MBI_SHORT_THRESHOLD ){
+      mbiMulLoBasecase( n, p, a, b );
+      return;
+    }
+    
+    bigintlength k = mbiMuldersSplit( n );
+    bigintlength l = n - k;
+    bool carry;
+    
+    /* Full product of the lower k digits, 2k >= n */
+    mbiMultiplyNScratch( k, p, a, b, scratch );
+    
+    /* Lower l digits of the two cross products, added at position k */
+    mbiMulLoScratch( l, p + n, a + k, b, scratch );
+    carry = false;
+    mbiAdd( l, p + k, p + n, &carry );
+    
+    mbiMulLoScratch( l, p + n, a, b + k, scratch );
+    carry = false;
+    mbiAdd( l, p + k, p + n, &carry );
+    
+  }
+  
+  /*
+  * Computes the lower half of a product
+  * Remark: a and b have n digits, p points to n digits which receive the
+    lower n digits of a*b, i.e. a*b modulo B^n. p must not overlap with a
+    or b.
+  */
+  void mbiMulLo( bigintlength n, bigint* p, const bigint* a, const bigint* b )
+  {
+    if( n < MBI_SHORT_THRESHOLD ){
+      mbiMulLoBasecase( n, p, a, b );
+      return;
+    }
+    size_t bytes = sizeof(bigint) * ( 2*n + mbiShortScratchSize( n ) );
+    bigint* temp = mbiAlloc( bytes );
+    assert( temp != NULL );
+    mbiMulLoScratch( n, temp, a, b, temp + 2*n );
+    mbiCopy( n, p, temp );
+    mbiFree( temp, bytes );
+  }
+  
+  
+  /*
+  * Approximates the upper half of a product, school method
+  * Remark: a and b have n digits, p points to 2n digits. p[n..2n) receives
+    an approximation of the upper half of a*b: it is never larger than the
+    true value and smaller by less than n units of p[n]. Only the digit
+    products a[i]*b[j] with i+j >= n-1 are formed; p[n-1] is used as a
+    guard digit and p[0..n-1) is not touched.
+  */
+  void mbiMulHiApproxBasecase( bigintlength n, bigint* p, const bigint* a, const bigint* b )
+  {
+    bigint* r = p + n - 1;
+    r[0] = mbiMulDigits( a[n-1], b[0], &r[1] );
+    for( bigintlength i = 1; i < n; i++ )
+      r[i+1] = mbiAddMulLimb( i+1, r, a + n - i - 1, b[i] );
+  }
+  
+  /*
+  * Approximates the upper half of a product
+  * Remark: Like MulHiApproxBasecase, with the same error bound, but for
+    larger n the upper k digits are multiplied in full and the two cross
+    terms by recursion. p[0..n-1) is used as temporary memory and scratch
+    has ShortScratchSize(n) digits.
+  */
+  void mbiMulHiApproxScratch( bigintlength n, bigint* p, const bigint* a, const bigint* b, bigint* scratch )
+  {
+    
+    if( n < MBI_SHORT_THRESHOLD ){
+      mbiMulHiApproxBasecase( n, p, a, b );
+      return;
+    }
+    
+    bigintlength k = mbiMuldersSplit( n );
+    bigintlength l = n - k;
+    bool carry;
+    bigint cy = 0;
+    
+    /* Full product of the upper k digits into p[2l..2n) */
+    mbiMultiplyNScratch( k, p + 2*l, a + l, b + l, scratch );
+    
+    /* Upper halves of the cross products fill p[l-1..2l), add at n-1 */
+    mbiMulHiApproxScratch( l, p, a + k, b, scratch );
+    carry = false;
+    mbiAdd( l + 1, p + n - 1, p + l - 1, &carry );
+    cy += carry;
+    
+    mbiMulHiApproxScratch( l, p, a, b + k, scratch );
+    carry = false;
+    mbiAdd( l + 1, p + n - 1, p + l - 1, &carry );
+    cy += carry;
+    
+    /* Propagate the carries */
+    for( bigint c = 0; c < cy; c++ ){
+      carry = false;
+      mbiInc( k, p + n + l, &carry );
+    }
+    
+  }
+  
+  /*
+  * Computes the upper half of a product
+  * Remark: a and b have n digits, p points to n digits which receive the
+    upper n digits of a*b, i.e. a*b divided by B^n and rounded down. p
+    must not overlap with a or b.
+    The upper half is approximated with one guard digit below it, by
+    MulHiApprox on the factors shifted up by one digit. The error is below
+    n+1 units of the guard digit, so unless the guard digit is that close
+    to overflowing, the approximation is exact; otherwise the full product
+    is computed. For random factors that happens with probability n/B.
+  */
+  void mbiMulHi( bigintlength n, bigint* p, const bigint* a, const bigint* b )
+  {
+    
+    if( n == 0 ) return;
+    
+    bigintlength m = n + 1;
+    size_t bytes = sizeof(bigint) * ( 4*m + mbiShortScratchSize( m ) );
+    bigint* temp = mbiAlloc( bytes );
+    assert( temp != NULL );
+    bigint *as = temp + 2*m, *bs = temp + 3*m;
+    
+    as[0] = bs[0] = 0;
+    mbiCopy( n, as + 1, a );
+    mbiCopy( n, bs + 1, b );
+    
+    mbiMulHiApproxScratch( m, temp, as, bs, temp + 4*m );
+    
+    if( temp[m] <= DIGIT_MAX - m ){
+      mbiCopy( n, p, temp + m + 1 );
+    }else{
+      mbiMultiplyN( n, temp, a, b );
+      mbiCopy( n, p, temp + n );
+    }
+    
+    mbiFree( temp, bytes );
+  }
+
+  
+  
+  
+  
+  /*******************************************************/
+  /* Prepared factors                                    */
+  /*******************************************************/
+  
+  /*
+  * When many numbers are multiplied with the same factor b, the differences
+  * |bl-bh| which Karatsuba-Ofmann forms at every level of the recursion
+  * only depend on b and can be computed once. A prepared factor keeps a copy
+  * of b and these differences with their signs for the upper depth levels
+  * of the recursion; the storage grows by a factor of 3/2 per level, so
+  * the depth is chosen from a memory limit.
+  */
+  
+  typedef struct {
+    bigintexpo k;
+    bigintexpo depth;
+    bigint* digits;
+    bigint* tree;
+    size_t bytes;
+  } bigintprepared;
+  
+  
+  /*
+  * Returns the memory in bytes a prepared factor of 2^k digits needs
+  * Remark: None
+  */
+  size_t mbiPreparedSize( bigintexpo k, bigintexpo depth )
+  {
+    return sizeof(bigint) * ( ((bigintlength)1 << k) + mbiPreparedTreeSize( k, depth ) );
+  }
+  
+  /*
+  * Computes the differences of the halves of b for depth levels
+  * Remark: node points to PreparedTreeSize(k, depth) digits.
+  */
+  void mbiPrepareTree( bigintexpo k, const bigint* b, bigint* node, bigintexpo depth )
+  {
+    bigintlength c = mbiPreparedTreeSize( k, depth );
+    if( c == 0 ) return;
+    
+    bigintlength h = (bigintlength)1 << (k-1);
+    node[0] = mbiCopyAbsSub( h, node + 1, b, h, b + h );
+    
+    c = mbiPreparedTreeSize( k-1, depth-1 );
+    mbiPrepareTree( k-1, node + 1, node + 1 + h, depth-1 );
+    mbiPrepareTree( k-1, b,        node + 1 + h + c, depth-1 );
+    mbiPrepareTree( k-1, b + h,    node + 1 + h + 2*c, depth-1 );
+  }
+  
+  /*
+  * Prepares a factor for repeated multiplication
+  * Remark: b has 2^k digits and is copied. As many levels are prepared as
+    fit into maxbytes, but at least the copy is made. Returns false if the
+    memory could not be allocated.
+  */
+  bool mbiPrepare( bigintprepared* x, bigintexpo k, const bigint* b, size_t maxbytes )
+  {
+    bigintexpo depth = 0;
+    while( k - depth > MBI_BASECASE_EXPONENT && mbiPreparedSize( k, depth+1 ) <= maxbytes )
+      depth++;
+    
+    x->k      = k;
+    x->depth  = depth;
+    x->bytes  = mbiPreparedSize( k, depth );
+    x->digits = mbiAlloc( x->bytes );
+    x->tree   = NULL;
+    if( x->digits == NULL ) return false;
+    x->tree   = x->digits + ((bigintlength)1 << k);
+    
+    mbiCopy( (bigintlength)1 << k, x->digits, b );
+    mbiPrepareTree( k, x->digits, x->tree, depth );
+    return true;
+  }
+  
+  /*
+  * Frees a prepared factor
+  * Remark: None
+  */
+  void mbiPreparedFree( bigintprepared* x )
+  {
+    mbiFree( x->digits, x->bytes );
+    x->digits = x->tree = NULL;
+    x->bytes  = 0;
+  }
+  
+  /*
+  * Multiplies a Big Int with a prepared factor
+  * Remark: a has 2^k digits, where k is the one of the prepared factor, and
+    p points to 2^{k+1} digits the result is saved in.
+  */
+  void mbiMultiplyPrepared( bigint* p, const bigint* a, const bigintprepared* b )
+  {
+    mbiMultiplyCoreAlloc( b->k, p, a, b->digits, b->depth > 0 ? b->tree : NULL, b->depth );
+  }
+  
+  
+  /*
+  * A pool keeps the prepared versions of a few frequently used factors,
+  * within a limit on their total memory. Factors are looked up by address
+  * and length, and their digits are compared with the copy, so a changed
+  * factor is prepared again. When the limit is exceeded, the least
+  * recently used factors are dropped.
+  */
+  
+  typedef struct {
+    const bigint* key;
+    bigintprepared prepared;
+    unsigned long lastuse;
+  } bigintpoolentry;
+  
+  typedef struct {
+    size_t capacity;
+    size_t used;
+    bigintlength count;
+    bigintlength size;
+    bigintpoolentry* entries;
+    unsigned long tick;
+  } bigintpool;
+  
+  
+  /*
+  * Initializes an empty pool
+  * Remark: capacity is the limit for the memory of all prepared factors,
+    in bytes.
+  */
+  void mbiPoolInit( bigintpool* pool, size_t capacity )
+  {
+    pool->capacity = capacity;
+    pool->used     = 0;
+    pool->count    = 0;
+    pool->size     = 0;
+    pool->entries  = NULL;
+    pool->tick     = 0;
+  }
+  
+  /*
+  * Frees a pool and all its prepared factors
+  * Remark: None
+  */
+  void mbiPoolFree( bigintpool* pool )
+  {
+    for( bigintlength i = 0; i < pool->count; i++ )
+      mbiPreparedFree( &pool->entries[i].prepared );
+    mbiFree( pool->entries, pool->size * sizeof(bigintpoolentry) );
+    mbiPoolInit( pool, pool->capacity );
+  }
+  
+  /*
+  * Drops an entry of a pool
+  * Remark: The last entry takes its place.
+  */
+  void mbiPoolDrop( bigintpool* pool, bigintlength i )
+  {
+    pool->used -= pool->entries[i].prepared.bytes;
+    mbiPreparedFree( &pool->entries[i].prepared );
+    pool->entries[i] = pool->entries[--pool->count];
+  }
+  
+  /*
+  * Returns the prepared version of a factor
+  * Remark: b has 2^k digits. The result stays valid until the next call
+    with this pool. A factor is prepared with the depth that fits into the
+    whole capacity; then least recently used entries are dropped until the
+    pool fits again. Returns NULL if memory could not be allocated, or if
+    the copy of b alone exceeds the capacity.
+  */
+  const bigintprepared* mbiPoolGet( bigintpool* pool, bigintexpo k, const bigint* b )
+  {
+    pool->tick++;
+    
+    for( bigintlength i = 0; i < pool->count; i++ )
+    {
+      bigintpoolentry* e = &pool->entries[i];
+      if( e->key != b || e->prepared.k != k ) continue;
+      if( mbiCompare( (bigintlength)1 << k, e->prepared.digits, b ) == 0 ){
+        e->lastuse = pool->tick;
+        return &e->prepared;
+      }
+      mbiPoolDrop( pool, i );
+      break;
+    }
+    
+    if( mbiPreparedSize( k, 0 ) > pool->capacity ) return NULL;
+    
+    if( pool->count == pool->size ){
+      bigintlength size = pool->size ? 2*pool->size : 4;
+      bigintpoolentry* entries = mbiRealloc( pool->entries, pool->size * sizeof(bigintpoolentry), size * sizeof(bigintpoolentry) );
+      if( entries == NULL ) return NULL;
+      pool->entries = entries;
+      pool->size    = size;
+    }
+    
+    bigintpoolentry e;
+    e.key     = b;
+    e.lastuse = pool->tick;
+    if( !mbiPrepare( &e.prepared, k, b, pool->capacity ) ) return NULL;
+    
+    /* Drop the least recently used entries */
+    while( pool->count > 0 && pool->used + e.prepared.bytes > pool->capacity )
+    {
+      bigintlength lru = 0;
+      for( bigintlength i = 1; i < pool->count; i++ )
+        if( pool->entries[i].lastuse < pool->entries[lru].lastuse ) lru = i;
+      mbiPoolDrop( pool, lru );
+    }
+    
+    pool->used += e.prepared.bytes;
+    pool->entries[pool->count] = e;
+    return &pool->entries[pool->count++].prepared;
+  }
+  
+  /*
+  * Multiplies a Big Int with a factor from a pool
+  * Remark: a and b have 2^k digits, p points to 2^{k+1} digits. b is
+    prepared on its first use.
+  */
+  void mbiPoolMultiply( bigintpool* pool, bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  {
+    const bigintprepared* x = mbiPoolGet( pool, k, b );
+    if( x != NULL )
+      mbiMultiplyPrepared( p, a, x );
+    else
+      mbiMultiply( k, p, a, b );
+  }
+
+  
+  
+  
+  
+  /*********************************************/
+  /* Non-essential operations                  */
+  /* for an easier handling                    */
+  /*********************************************/
+    
+  /*
+  * Returns an exponent k, s.t. n <= 2^{k}
+  * Bemerkung: Absolutely no optimization
+  */
+  bigintexpo getFittingExponent( bigintlength n )
+  {
+    bigintexpo k = 0;
+    while ( (bigintlength)(1L<<k) < n && k <= (bigintexpo)254 ) k++;
+    return k;
+  }
+  
+  
+    
+  /*
+  * Multiplies numbers of arbitrary length
+  * Remark: It wraps the karatsuba-multiplication, s.t. we can multiply numbers
+  * whose length is not a power of 2. Absolutely no optimization for this
+  */
+  void mbiMultiplikation( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2 )
+  {
+    
+    assert( dest != NULL );
+    assert( fak1 != NULL );
+    assert( fak2 != NULL );
+    
+    bigintlength nmax = n1 > n2 ? n1 : n2;
+    bigintexpo k = getFittingExponent( nmax );
+    
+    if( (1L<<k) == 0 ){
+      printf( "Error: Summands are to long\n" );
+      return;
+    }
+    
+    bigint *tempfak1, *tempfak2;
+    bigint *tempdest;
+    
+    tempdest = mbiAlloc( sizeof(bigint) * (1<<k) * 4 );
+    tempfak1 = tempdest + (1<<k)*2;
+    tempfak2 = tempdest + (1<<k)*3;
+//     tempfak1 = calloc( sizeof(bigint) , (1<<k) ); 
+//     tempfak2 = calloc( sizeof(bigint) , (1<<k) );
+//     tempdest = calloc( sizeof(bigint) , (1<<k)*2 );
+    
+    assert( tempdest != NULL );
+    assert( tempfak1 != NULL );
+    assert( tempfak2 != NULL );
+    
+    mbiSetZero( (1<<k) * 2, tempfak1 );
+    mbiCopy( n1, tempfak1, fak1 );
+    mbiCopy( n2, tempfak2, fak2 );
+    
+    mbiMultiply( k, tempdest, tempfak1, tempfak2 );
+    
+    mbiCopy( n1+n2, dest, tempdest );
+    
+    //free( tempfak1 );
+    //free( tempfak2 );
+    mbiFree( tempdest, sizeof(bigint) * (1<<k) * 4 );
+  } 
+  
+  
+  /*
+  * Returns the number of digits of scratch memory for AddMulScratch
+  * Remark: For the shorter factor of m digits and h = m - m/2, one
+    product of 2h digits, the differences of the halves of 2h digits and
+    the scratch memory of MultiplyNScratch(h).
+  */
+  bigintlength mbiAddMulScratchSize( bigintlength n1, bigintlength n2 )
+  {
+    bigintlength m = n1 < n2 ? n1 : n2;
+    if( m <= ((bigintlength)1 << MBI_BASECASE_EXPONENT) ) return 0;
+    bigintlength h = m - m/2;
+    return 4*h + mbiMultiplyNScratchSize( h );
+  }
+  
+  /*
+  * Adds a product onto a Big Int
+  * Remark: dest += a*b, where a has n1, b has n2 and dest has nd >= n1+n2
+    digits; the carry is propagated up to the top of dest. Returns true if
+    the sum runs out of dest. dest must not overlap with a or b, scratch
+    points to AddMulScratchSize(n1, n2) digits.
+    Short factors are added row by row by AddMul2Limbs. For factors of the
+    same length, the upper level of Karatsuba-Ofmann is folded into dest:
+    the products of the halves are added, or subtracted, at their places
+    right away, so no product of the full length is formed. A longer
+    factor is cut into blocks of the length of the shorter one.
+  */
+  bool mbiAddMulScratch( bigintlength nd, bigint* dest, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b, bigint* scratch )
+  {
+    
+    assert( nd >= n1 + n2 );
+    
+    /* let a be the longer factor */
+    if( n1 < n2 ){
+      const bigint* t = a; a = b; b = t;
+      bigintlength tn = n1; n1 = n2; n2 = tn;
+    }
+    
+    int carries = 0;
+    
+    if( n2 <= ((bigintlength)1 << MBI_BASECASE_EXPONENT) ){
+      bigintlength j = 0;
+      for( ; j + 1 < n2; j += 2 ){
+        bigint hi, lo = mbiAddMul2Limbs( n1, dest + j, a, b[j], b[j+1], &hi );
+        carries += mbiAddDigit( nd - j - n1, dest + j + n1, lo );
+        carries += mbiAddDigit( nd - j - n1 - 1, dest + j + n1 + 1, hi );
+      }
+      if( j < n2 ){
+        bigint c = mbiAddMulLimb( n1, dest + j, a, b[j] );
+        carries += mbiAddDigit( nd - j - n1, dest + j + n1, c );
+      }
+      return carries != 0;
+    }
+    
+    if( n1 > n2 ){
+      for( bigintlength off = 0; off < n1; off += n2 )
+      {
+        bigintlength c = n1 - off < n2 ? n1 - off : n2;
+        carries += mbiAddMulScratch( nd - off, dest + off, c, a + off, n2, b, scratch );
+      }
+      return carries != 0;
+    }
+    
+    bigintlength l = n1/2;
+    bigintlength h = n1 - l;
+    bigint *t = scratch, *da = scratch + 2*h, *db = da + h;
+    scratch = db + h;
+    
+    /* a0 b0 at positions 0 and l */
+    mbiMultiplyNScratch( l, t, a, b, scratch );
+    carries += mbiAddInto( nd, dest, 2*l, t );
+    carries += mbiAddInto( nd - l, dest + l, 2*l, t );
+    
+    /* a1 b1 at positions 2l and l */
+    mbiMultiplyNScratch( h, t, a + l, b + l, scratch );
+    carries += mbiAddInto( nd - 2*l, dest + 2*l, 2*h, t );
+    carries += mbiAddInto( nd - l, dest + l, 2*h, t );
+    
+    /* -(a0 - a1)(b0 - b1) at position l */
+    bool nega = mbiCopyAbsSub( l, da, a, h, a + l );
+    bool negb = mbiCopyAbsSub( l, db, b, h, b + l );
+    mbiMultiplyNScratch( h, t, da, db, scratch );
+    if( nega != negb )
+      carries += mbiAddInto( nd - l, dest + l, 2*h, t );
+    else
+      carries -= mbiSubFrom( nd - l, dest + l, 2*h, t );
+    
+    return carries != 0;
+  }
+  
+  /*
+  * Adds a product onto a Big Int
+  * Remark: Works like AddMulScratch and allocates the scratch memory.
+  */
+  bool mbiAddMul( bigintlength nd, bigint* dest, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    bigintlength s = mbiAddMulScratchSize( n1, n2 );
+    bigint* scratch = NULL;
+    if( s > 0 ){
+      scratch = mbiAlloc( sizeof(bigint) * s );
+      assert( scratch != NULL );
+    }
+    bool carry = mbiAddMulScratch( nd, dest, n1, a, n2, b, scratch );
+    mbiFree( scratch, sizeof(bigint) * s );
+    return carry;
+  }
+  
+  
+  /*
+  * Returns the number of digits of scratch memory for MultiplyUnbalancedScratch
+  * Remark: Enough for MultiplyN of the shorter length as well, since
+    callers reuse the scratch for shorter factors.
+  */
+  bigintlength mbiMultiplyUnbalancedScratchSize( bigintlength n1, bigintlength n2 )
+  {
+    bigintlength m = n1 < n2 ? n1 : n2;
+    bigintlength s = mbiAddMulScratchSize( n1, n2 );
+    bigintlength sn = mbiMultiplyNScratchSize( m );
+    return s > sn ? s : sn;
+  }
+  
+  /*
+  * Multiplies numbers of arbitrary, possibly very different length
+  * Remark: dest points to n1+n2 digits and must not overlap with the
+    factors. Factors of the same length go to MultiplyN, else the longer
+    factor is cut into blocks of the length of the shorter one, whose
+    products are added onto dest by AddMul. So the cost is about
+    (n_long/n_short) Karatsuba products of the short size instead of one
+    product of the long size. scratch points to
+    MultiplyUnbalancedScratchSize(n1, n2) digits.
+  */
+  void mbiMultiplyUnbalancedScratch( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2, bigint* scratch )
+  {
+    
+    assert( dest != NULL );
+    assert( fak1 != NULL );
+    assert( fak2 != NULL );
+    
+    if( n1 == n2 && n1 > ((bigintlength)1 << MBI_BASECASE_EXPONENT) ){
+      mbiMultiplyNScratch( n1, dest, fak1, fak2, scratch );
+      return;
+    }
+    
+    mbiSetZero( n1+n2, dest );
+    mbiAddMulScratch( n1+n2, dest, n1, fak1, n2, fak2, scratch );
+    
+  }
+  
+  /*
+  * Multiplies numbers of arbitrary, possibly very different length
+  * Remark: Works like MultiplyUnbalancedScratch and allocates the scratch
+    memory.
+  */
+  void mbiMultiplyUnbalanced( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2 )
+  {
+    bigintlength s = mbiMultiplyUnbalancedScratchSize( n1, n2 );
+    bigint* scratch = NULL;
+    if( s > 0 ){
+      scratch = mbiAlloc( sizeof(bigint) * s );
+      assert( scratch != NULL );
+    }
+    mbiMultiplyUnbalancedScratch( dest, n1, fak1, n2, fak2, scratch );
+    mbiFree( scratch, sizeof(bigint) * s );
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Multiplication within a memory budget     */
+  /*********************************************/
+  
+  /*
+  * Workers with a hard memory cap pass the number of bytes of scratch
+  * memory they can spare, and the fastest method that fits is taken:
+  *
+  * - MBI_BUDGET_KARATSUBA: MultiplyN for factors of the same length, else
+  *   MultiplyUnbalanced, about 2n and 3n digits.
+  * - MBI_BUDGET_CHUNKED: both factors are cut into chunks of c digits, and
+  *   the products of the chunks are found by MultiplyN and added into the
+  *   result. This needs 4c digits and the scratch of MultiplyN(c), about
+  *   6c, and costs (n1/c)(n2/c) Karatsuba products of c digits, so c is
+  *   as large as the budget allows.
+  * - MBI_BUDGET_SCHOOL: the school method straight into the result,
+  *   without any scratch memory.
+  *
+  * The stack frames of the recursion, O(log n) of them, are not counted.
+  */
+  
+  #define MBI_BUDGET_KARATSUBA 0
+  #define MBI_BUDGET_CHUNKED   1
+  #define MBI_BUDGET_SCHOOL    2
+  
+  /* Shorter chunks are slower than the school method */
+  #ifndef MBI_BUDGET_CHUNK
+  #define MBI_BUDGET_CHUNK 256
+  #endif
+  
+  typedef struct {
+    int strategy;        /* one of MBI_BUDGET_* */
+    bigintlength chunk;  /* chunk length of MBI_BUDGET_CHUNKED */
+    size_t peak;         /* bytes of scratch memory used */
+  } bigintbudget;
+  
+  /*
+  * Returns the number of digits of scratch memory MultiplyChunked needs
+  * Remark: c is the chunk length.
+  */
+  bigintlength mbiMultiplyChunkedScratchSize( bigintlength c )
+  {
+    return 4*c + mbiMultiplyNScratchSize( c );
+  }
+  
+  /*
+  * Multiplies numbers of arbitrary length chunk by chunk
+  * Remark: dest points to n1+n2 digits and must not overlap with the
+    factors, scratch points to MultiplyChunkedScratchSize(c) digits. Chunk
+    products with a short side go to the school method directly, the
+    others are padded to c digits if necessary.
+  */
+  void mbiMultiplyChunked( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2, bigintlength c, bigint* scratch )
+  {
+    
+    assert( c > 0 );
+    
+    bigint *t  = scratch;
+    bigint *pa = scratch + 2*c;
+    bigint *pb = scratch + 3*c;
+    scratch    = scratch + 4*c;
+    
+    mbiSetZero( n1+n2, dest );
+    
+    for( bigintlength i = 0; i < n1; i += c )
+    {
+      bigintlength ca = n1 - i < c ? n1 - i : c;
+      
+      for( bigintlength j = 0; j < n2; j += c )
+      {
+        bigintlength cb = n2 - j < c ? n2 - j : c;
+        
+        if( ca <= ((bigintlength)1 << MBI_BASECASE_EXPONENT) || cb <= ((bigintlength)1 << MBI_BASECASE_EXPONENT) ){
+          mbiMulBasecase( t, ca, fak1 + i, cb, fak2 + j );
+        }else{
+          const bigint *x = fak1 + i, *y = fak2 + j;
+          if( ca < c ){
+            mbiCopy( ca, pa, x );
+            mbiSetZero( c - ca, pa + ca );
+            x = pa;
+          }
+          if( cb < c ){
+            mbiCopy( cb, pb, y );
+            mbiSetZero( c - cb, pb + cb );
+            y = pb;
+          }
+          mbiMultiplyNScratch( c, t, x, y, scratch );
+        }
+        
+        /* the chunk product has at most ca+cb significant digits */
+        bool carry = false;
+        mbiAdd( ca + cb, dest + i + j, t, &carry );
+        if( carry && i + j + ca + cb < n1 + n2 ){
+          carry = false;
+          mbiInc( n1 + n2 - i - j - ca - cb, dest + i + j + ca + cb, &carry );
+        }
+      }
+    }
+    
+  }
+  
+  /*
+  * Plans a multiplication within a memory budget
+  * Remark: Chooses the method for factors of n1 and n2 digits with at
+    most budget bytes of scratch memory, writes it to plan and returns the
+    bytes it uses, which is plan->peak.
+  */
+  size_t mbiMultiplyBudgetPlan( bigintbudget* plan, bigintlength n1, bigintlength n2, size_t budget )
+  {
+    const bigintlength base = MBI_BUDGET_CHUNK;
+    bigintlength m = n1 < n2 ? n1 : n2;
+    bigintlength digits = budget / sizeof(bigint);
+    bigintlength need = ( n1 == n2 ) ? mbiMultiplyNScratchSize( m ) : mbiMultiplyUnbalancedScratchSize( n1, n2 );
+    
+    plan->chunk = 0;
+    plan->peak  = 0;
+    
+    if( need <= digits ){
+      plan->strategy = MBI_BUDGET_KARATSUBA;
+      plan->peak     = need * sizeof(bigint);
+      return plan->peak;
+    }
+    
+    if( m <= base || mbiMultiplyChunkedScratchSize( base ) > digits ){
+      plan->strategy = MBI_BUDGET_SCHOOL;
+      return 0;
+    }
+    
+    /* The longest chunk that fits, the scratch size grows with c */
+    bigintlength lo = base, hi = m;
+    while( lo < hi )
+    {
+      bigintlength c = lo + ( hi - lo + 1 ) / 2;
+      if( mbiMultiplyChunkedScratchSize( c ) <= digits ) lo = c;
+      else hi = c - 1;
+    }
+    
+    /* Even out the chunks of the shorter factor, which does not make c longer */
+    bigintlength chunks = ( m + lo - 1 ) / lo;
+    bigintlength c = ( m + chunks - 1 ) / chunks;
+    if( c < base ) c = base;
+    
+    plan->strategy = MBI_BUDGET_CHUNKED;
+    plan->chunk    = c;
+    plan->peak     = mbiMultiplyChunkedScratchSize( c ) * sizeof(bigint);
+    return plan->peak;
+  }
+  
+  /*
+  * Multiplies numbers of arbitrary length within a memory budget
+  * Remark: dest points to n1+n2 digits and must not overlap with the
+    factors. scratch points to budget bytes, which is all the memory used.
+    The chosen method and its peak use are written to report, unless it
+    is NULL.
+  */
+  void mbiMultiplyBudgetScratch( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2, void* scratch, size_t budget, bigintbudget* report )
+  {
+    bigintbudget plan;
+    mbiMultiplyBudgetPlan( &plan, n1, n2, budget );
+    
+    switch( plan.strategy )
+    {
+      case MBI_BUDGET_KARATSUBA:
+        if( n1 == n2 ) mbiMultiplyNScratch( n1, dest, fak1, fak2, (bigint*)scratch );
+        else mbiMultiplyUnbalancedScratch( dest, n1, fak1, n2, fak2, (bigint*)scratch );
+        break;
+        
+      case MBI_BUDGET_CHUNKED:
+        mbiMultiplyChunked( dest, n1, fak1, n2, fak2, plan.chunk, (bigint*)scratch );
+        break;
+        
+      default:
+        mbiMulBasecase( dest, n1, fak1, n2, fak2 );
+        break;
+    }
+    
+    if( report != NULL ) *report = plan;
+  }
+  
+  /*
+  * Multiplies numbers of arbitrary length within a memory budget
+  * Remark: Works like MultiplyBudgetScratch and allocates the scratch
+    memory the chosen method needs, which is at most budget bytes. It is
+    taken from malloc with its exact size, as mbiAlloc rounds up to size
+    classes and keeps freed blocks.
+  */
+  void mbiMultiplyBudget( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2, size_t budget, bigintbudget* report )
+  {
+    bigintbudget plan;
+    size_t bytes = mbiMultiplyBudgetPlan( &plan, n1, n2, budget );
+    void* scratch = NULL;
+    if( bytes > 0 ){
+      scratch = malloc( bytes );
+      assert( scratch != NULL );
+    }
+    mbiMultiplyBudgetScratch( dest, n1, fak1, n2, fak2, scratch, bytes, report );
+    free( scratch );
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Polynomials                               */
+  /*********************************************/
+  
+  /*
+  * Polynomials with small integer coefficients are multiplied by Kronecker
+  * substitution: the coefficients are packed into slots of w bits of one
+  * Big Int, i.e. the polynomial is evaluated at 2^w, the two numbers are
+  * multiplied by the integer multiplication, and the coefficients of the
+  * product are read back from the slots. w is large enough that no
+  * coefficient of the product overflows its slot, so polynomial products
+  * get faster with every improvement of the integer multiplication.
+  *
+  * Negative coefficients are packed as the difference of the numbers of
+  * the positive and of the negative coefficients. A slot of the product
+  * then holds its coefficient minus a borrow to the slot above, which is
+  * undone while unpacking.
+  */
+  
+  /*
+  * Returns the bits per slot for the product of two polynomials
+  * Remark: a has n1 and b has n2 coefficients. A slot holds
+    min(n1,n2)*max|a_i|*max|b_i| and a sign bit. Returns 0 if a or b is
+    zero.
+  */
+  unsigned int mbiPolySlotBits( size_t n1, const int64_t* a, size_t n2, const int64_t* b )
+  {
+    uint64_t ma = 0, mb = 0;
+    size_t i;
+    
+    for( i = 0; i < n1; i++ ) ma |= a[i] < 0 ? -(uint64_t)a[i] : (uint64_t)a[i];
+    for( i = 0; i < n2; i++ ) mb |= b[i] < 0 ? -(uint64_t)b[i] : (uint64_t)b[i];
+    if( ma == 0 || mb == 0 ) return 0;
+    
+    /* or-ing the magnitudes keeps the highest bit of the largest one */
+    unsigned int bits = 1;
+    bits += DIGIT_BITS - mbiDigitLeadingZeros( (bigint)ma );
+    bits += DIGIT_BITS - mbiDigitLeadingZeros( (bigint)mb );
+    bits += DIGIT_BITS - mbiDigitLeadingZeros( (bigint)( n1 < n2 ? n1 : n2 ) );
+    return bits;
+  }
+  
+  /*
+  * Packs the coefficients of a polynomial into a Big Int
+  * Remark: a has m coefficients, x and t point to n digits each, enough
+    for m slots of w bits. x gets the absolute value of a(2^w), t is
+    overwritten. Returns true if a(2^w) is negative.
+  */
+  bool mbiPolyPack( bigintlength n, bigint* x, bigint* t, unsigned int w, size_t m, const int64_t* a )
+  {
+    mbiSetZero( n, x );
+    mbiSetZero( n, t );
+    
+    for( size_t i = 0; i < m; i++ )
+      if( a[i] > 0 )
+        mbiOrBitField( x, (unsigned long)i * w, w, (bigint)a[i] );
+      else if( a[i] < 0 )
+        mbiOrBitField( t, (unsigned long)i * w, w, (bigint)( -(uint64_t)a[i] ) );
+    
+    bool carry = false;
+    if( mbiCompare( n, x, t ) >= 0 ){
+      mbiSub( n, x, t, &carry );
+      return false;
+    }
+    mbiSub( n, t, x, &carry );
+    mbiCopy( n, x, t );
+    return true;
+  }
+  
+  /*
+  * Unpacks the coefficients of a polynomial from a Big Int
+  * Remark: z has n digits and is the absolute value of c(2^w), which is
+    negative if negative is true. The m coefficients of c must be less
+    than 2^{w-1} in absolute value. The slots are read by GetBitFields
+    first, then the borrows are undone from the bottom up.
+  */
+  void mbiPolyUnpack( size_t m, int64_t* c, unsigned int w, bigintlength n, const bigint* z, bool negative )
+  {
+    uint64_t* u = (uint64_t*)c;
+    mbiGetBitFields( n, z, w, m, (bigint*)u );
+    
+    uint64_t mask = w < 64 ? ( (uint64_t)1 << w ) - 1 : ~(uint64_t)0;
+    uint64_t half = (uint64_t)1 << ( w - 1 );
+    uint64_t carry = 0;
+    
+    for( size_t j = 0; j < m; j++ )
+    {
+      uint64_t s = ( u[j] + carry ) & mask;
+      
+      /* a full slot plus the carry wraps to zero and passes the carry on */
+      if( s & half ){
+        c[j] = (int64_t)( s | ~mask );
+        carry = 1;
+      }else{
+        c[j] = (int64_t)s;
+        carry = ( carry && s == 0 );
+      }
+      
+      if( negative ) c[j] = -c[j];
+    }
+  }
+  
+  /*
+  * Multiplies two polynomials with integer coefficients
+  * Remark: a has n1 > 0 and b has n2 > 0 coefficients, the lowest first,
+    and c gets the n1+n2-1 coefficients of the product. c must not overlap
+    with a or b, while a and b may be the same, then the product is
+    computed as a square. Returns false and leaves c untouched if the
+    coefficients of the product might not fit into a slot of a digit, i.e.
+    if PolySlotBits exceeds DIGIT_BITS.
+  */
+  bool mbiPolyMul( int64_t* c, size_t n1, const int64_t* a, size_t n2, const int64_t* b )
+  {
+    assert( n1 > 0 && n2 > 0 );
+    
+    size_t m = n1 + n2 - 1;
+    unsigned int w = mbiPolySlotBits( n1, a, n2, b );
+    if( w > DIGIT_BITS ) return false;
+    if( w == 0 ){
+      memset( c, 0, sizeof(int64_t) * m );
+      return true;
+    }
+    
+    bool square = ( a == b && n1 == n2 );
+    bigintlength la = ( (bigintlength)n1 * w + DIGIT_BITS - 1 ) / DIGIT_BITS;
+    bigintlength lb = square ? 0 : ( (bigintlength)n2 * w + DIGIT_BITS - 1 ) / DIGIT_BITS;
+    bigintlength lz = la + ( square ? la : lb );
+    size_t bytes = sizeof(bigint) * ( 2*la + 2*lb + lz );
+    
+    bigint* x = mbiAlloc( bytes );
+    assert( x != NULL );
+    bigint *tx = x + la, *y = tx + la, *ty = y + lb, *z = ty + lb;
+    
+    bool negx = mbiPolyPack( la, x, tx, w, n1, a );
+    bool negy = square ? negx : mbiPolyPack( lb, y, ty, w, n2, b );
+    
+    if( square )
+      mbiSquareN( la, z, x );
+    else if( la == lb )
+      mbiMultiplyN( la, z, x, y );
+    else
+      mbiMultiplyUnbalanced( z, la, x, lb, y );
+    
+    mbiPolyUnpack( m, c, w, lz, z, negx != negy );
+    
+    mbiFree( x, bytes );
+    return true;
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Big Int handles                           */
+  /*********************************************/
+  
+  /*
+  * A handle keeps the digits of a Big Int together with its capacity, its
+  * normalized length and its sign, so callers do not have to carry around
+  * (length, pointer) pairs. The length is always normalized, i.e. the top
+  * digit is non-zero, and zero has length 0 and is never negative. All
+  * operations only look at the significant digits.
+  *
+  * The memory of a handle is obtained through an allocator hook. A NULL
+  * allocator stands for mbiRealloc and mbiFree.
+  */
+  
+  typedef struct {
+    bigint* digits;
+    bigintlength capacity;
+    bigintlength length;
+    bool negative;
+    const bigintallocator* allocator;
+  } bigintnum;
+  
+  
+  /*
+  * Initializes a handle with the value zero
+  * Remark: No memory is allocated until the first digit is stored.
+    allocator may be NULL.
+  */
+  void mbiNumInit( bigintnum* x, const bigintallocator* allocator )
+  {
+    assert( x != NULL );
+    x->digits    = NULL;
+    x->capacity  = 0;
+    x->length    = 0;
+    x->negative  = false;
+    x->allocator = allocator;
+  }
+  
+  /*
+  * Frees the memory of a handle
+  * Remark: The handle is zero afterwards and may be used again.
+  */
+  void mbiNumFree( bigintnum* x )
+  {
+    assert( x != NULL );
+    if( x->digits != NULL ){
+      if( x->allocator != NULL )
+        x->allocator->release( x->allocator->context, x->digits, x->capacity * sizeof(bigint) );
+      else
+        mbiFree( x->digits, x->capacity * sizeof(bigint) );
+    }
+    mbiNumInit( x, x->allocator );
+  }
+  
+  /*
+  * Makes sure a handle can hold n digits
+  * Remark: The capacity grows at least geometrically, so a sequence of
+    growing results costs amortized linear time. The value is kept.
+  */
+  void mbiNumReserve( bigintnum* x, bigintlength n )
+  {
+    assert( x != NULL );
+    if( n <= x->capacity ) return;
+    
+    bigintlength c = 2 * x->capacity;
+    if( c < n ) c = n;
+    if( c < 4 ) c = 4;
+    
+    bigint* d;
+    if( x->allocator != NULL )
+      d = x->allocator->reallocate( x->allocator->context, x->digits, x->capacity * sizeof(bigint), c * sizeof(bigint) );
+    else
+      d = mbiRealloc( x->digits, x->capacity * sizeof(bigint), c * sizeof(bigint) );
+    assert( d != NULL );
+    
+    x->digits   = d;
+    x->capacity = c;
+  }
+  
+  /*
+  * Normalizes the length of a handle
+  * Remark: Drops leading zero digits. Zero is made non-negative.
+  */
+  void mbiNumNormalize( bigintnum* x )
+  {
+    while( x->length > 0 && x->digits[x->length-1] == 0 ) x->length--;
+    if( x->length == 0 ) x->negative = false;
+  }
+  
+  /*
+  * Exchanges the contents of two handles
+  * Remark: None
+  */
+  void mbiNumSwap( bigintnum* x, bigintnum* y )
+  {
+    bigintnum t = *x;
+    *x = *y;
+    *y = t;
+  }
+  
+  /*
+  * Sets a handle to a Big Int
+  * Remark: z points to n digits which may have leading zeros.
+  */
+  void mbiNumSet( bigintnum* x, bigintlength n, const bigint* z, bool negative )
+  {
+    while( n > 0 && z[n-1] == 0 ) n--;
+    mbiNumReserve( x, n );
+    if( n > 0 && x->digits != z ) mbiCopy( n, x->digits, z );
+    x->length   = n;
+    x->negative = negative;
+    mbiNumNormalize( x );
+  }
+  
+  /*
+  * Compares the absolute values of two handles
+  * Remark: Returns 1, 0 or -1 like Compare.
+  */
+  int mbiNumCompareAbs( const bigintnum* a, const bigintnum* b )
+  {
+    if( a->length != b->length ) return a->length > b->length ? 1 : -1;
+    return mbiCompare( a->length, a->digits, b->digits );
+  }
+  
+  /*
+  * Compares two handles
+  * Remark: Takes the signs into account, returns 1, 0 or -1 like Compare.
+  */
+  int mbiNumCompare( const bigintnum* a, const bigintnum* b )
+  {
+    if( a->negative != b->negative ) return a->negative ? -1 : 1;
+    int c = mbiNumCompareAbs( a, b );
+    return a->negative ? -c : c;
+  }
+  
+  
+  /*
+  * Adds or subtracts two handles
+  * Remark: Computes r = a + b or r = a - b, depending on subtract. r may be
+    the same handle as a or b. Only the significant digits are touched.
+  */
+  void mbiNumAddSub( bigintnum* r, const bigintnum* a, const bigintnum* b, bool subtract )
+  {
+    
+    /* Digits of b would be overwritten before they are read */
+    if( r == b && r != a ){
+      bigintnum t;
+      mbiNumInit( &t, r->allocator );
+      mbiNumAddSub( &t, a, b, subtract );
+      mbiNumSwap( r, &t );
+      mbiNumFree( &t );
+      return;
+    }
+    
+    bool bnegative = subtract ? !b->negative : b->negative;
+    
+    if( a->negative == bnegative ){
+      
+      /* Same signs: add the absolute values */
+      bigintlength n  = a->length > b->length ? a->length : b->length;
+      bigintlength la = a->length, lb = b->length;
+      const bigint* bd = b->digits;
+      
+      if( r == a && r == b ){
+        /* a + a, a - (-a) */
+        r->negative = bnegative;
+        mbiNumReserve( r, n+1 );
+        r->digits[n] = 0;
+        mbiBitLeftShift( n+1, r->digits, 1 );
+        r->length = n+1;
+        mbiNumNormalize( r );
+        return;
+      }
+      
+      mbiNumReserve( r, n+1 );
+      if( r != a && la > 0 ) mbiCopy( la, r->digits, a->digits );
+      mbiSetZero( n + 1 - la, r->digits + la );
+      
+      bool carry = false;
+      mbiAdd( lb, r->digits, bd, &carry );
+      if( carry ){
+        carry = false;
+        mbiInc( n + 1 - lb, r->digits + lb, &carry );
+      }
+      
+      r->length   = n+1;
+      r->negative = bnegative;
+      
+    }else{
+      
+      /* Different signs: subtract the smaller absolute value */
+      int c = mbiNumCompareAbs( a, b );
+      
+      if( c == 0 ){
+        r->length   = 0;
+        r->negative = false;
+        return;
+      }
+      
+      /* Let big be the operand with the larger absolute value */
+      const bigintnum *big = a, *small = b;
+      bool negative = a->negative;
+      if( c < 0 ){
+        big = b;
+        small = a;
+        negative = bnegative;
+      }
+      
+      if( r == small ){
+        bigintnum t;
+        mbiNumInit( &t, r->allocator );
+        mbiNumAddSub( &t, a, b, subtract );
+        mbiNumSwap( r, &t );
+        mbiNumFree( &t );
+        return;
+      }
+      
+      mbiNumReserve( r, big->length );
+      if( r != big ) mbiCopy( big->length, r->digits, big->digits );
+      
+      bool carry = false;
+      mbiSub( small->length, r->digits, small->digits, &carry );
+      if( carry ){
+        carry = false;
+        mbiDec( big->length - small->length, r->digits + small->length, &carry );
+      }
+      
+      r->length   = big->length;
+      r->negative = negative;
+      
+    }
+    
+    mbiNumNormalize( r );
+  }
+  
+  /*
+  * Adds two handles
+  * Remark: r = a + b, r may be the same handle as a or b.
+  */
+  void mbiNumAdd( bigintnum* r, const bigintnum* a, const bigintnum* b )
+  {
+    mbiNumAddSub( r, a, b, false );
+  }
+  
+  /*
+  * Subtracts two handles
+  * Remark: r = a - b, r may be the same handle as a or b.
+  */
+  void mbiNumSub( bigintnum* r, const bigintnum* a, const bigintnum* b )
+  {
+    mbiNumAddSub( r, a, b, true );
+  }
+  
+  /*
+  * Multiplies two handles
+  * Remark: r = a * b, r may be the same handle as a or b. Only the
+    significant digits are multiplied, so leading zeros of the inputs do
+    not cost anything, and factors of different length are multiplied
+    block-wise by MultiplyUnbalanced.
+  */
+  void mbiNumMul( bigintnum* r, const bigintnum* a, const bigintnum* b )
+  {
+    
+    if( a->length == 0 || b->length == 0 ){
+      r->length   = 0;
+      r->negative = false;
+      return;
+    }
+    
+    if( r == a || r == b ){
+      bigintnum t;
+      mbiNumInit( &t, r->allocator );
+      mbiNumMul( &t, a, b );
+      mbiNumSwap( r, &t );
+      mbiNumFree( &t );
+      return;
+    }
+    
+    mbiNumReserve( r, a->length + b->length );
+    mbiMultiplyUnbalanced( r->digits, a->length, a->digits, b->length, b->digits );
+    
+    r->length   = a->length + b->length;
+    r->negative = a->negative != b->negative;
+    mbiNumNormalize( r );
+  }
+  
+  /*
+  * Returns the number of bits of the absolute value of a handle
+  * Remark: Zero has 0 bits.
+  */
+  unsigned long mbiNumBits( const bigintnum* x )
+  {
+    if( x->length == 0 ) return 0;
+    return x->length * DIGIT_BITS - mbiDigitLeadingZeros( x->digits[x->length-1] );
+  }
+  
+  /*
+  * Shifts a handle to the left
+  * Remark: r = a * 2^s, r may be the same handle as a.
+  */
+  void mbiNumShiftLeft( bigintnum* r, const bigintnum* a, unsigned long s )
+  {
+    if( a->length == 0 ){
+      r->length   = 0;
+      r->negative = false;
+      return;
+    }
+    
+    bool negative = a->negative;
+    bigintlength n = a->length + s / DIGIT_BITS + 1;
+    if( r != a ) mbiNumSet( r, a->length, a->digits, negative );
+    mbiNumReserve( r, n );
+    mbiSetZero( n - r->length, r->digits + r->length );
+    mbiBitLeftShift( n, r->digits, s );
+    
+    r->length   = n;
+    r->negative = negative;
+    mbiNumNormalize( r );
+  }
+  
+  /*
+  * Shifts a handle to the right
+  * Remark: The absolute value of a is divided by 2^s and rounded down, or
+    up if roundup is true; the sign is kept. r may be the same handle as a.
+  */
+  void mbiNumShiftRight( bigintnum* r, const bigintnum* a, unsigned long s, bool roundup )
+  {
+    bigintlength q = s / DIGIT_BITS;
+    bool negative = a->negative;
+    bool inexact = false;
+    
+    if( roundup && a->length > 0 ){
+      bigintlength m = q < a->length ? q : a->length;
+      inexact = !mbiIsZero( m, a->digits );
+      if( !inexact && q < a->length && s % DIGIT_BITS != 0 )
+        inexact = ( a->digits[q] << ( DIGIT_BITS - s % DIGIT_BITS ) ) != 0;
+    }
+    
+    if( q >= a->length ){
+      r->length = 0;
+    }else{
+      bigintlength n = a->length;
+      if( r != a ) mbiNumReserve( r, n );
+      mbiBitRightShiftCopy( n, r->digits, a->digits, s );
+      r->length = n - q;
+    }
+    r->negative = negative;
+    mbiNumNormalize( r );
+    
+    if( inexact ){
+      mbiNumReserve( r, r->length + 1 );
+      r->digits[r->length] = 0;
+      bool carry = false;
+      mbiInc( r->length + 1, r->digits, &carry );
+      r->length++;
+      r->negative = negative;
+      mbiNumNormalize( r );
+    }
+  }
+  
+  /*
+  * Divides a handle by a single digit
+  * Remark: r = a / d rounded towards zero, the remainder of the absolute
+    values is returned. r may be the same handle as a.
+  */
+  bigint mbiNumDivLimb( bigintnum* r, const bigintnum* a, bigint d )
+  {
+    bool negative = a->negative;
+    bigintlength n = a->length;
+    mbiNumReserve( r, n );
+    bigint rem = mbiDivRemLimb( n, r->digits, a->digits, d );
+    r->length   = n;
+    r->negative = negative;
+    mbiNumNormalize( r );
+    return rem;
+  }
+
+  
+  
+  
+  
+  /*********************************************/
+  /* Product trees                             */
+  /*********************************************/
+  
+  /*
+  * A product of many numbers is computed in a balanced binary tree, so that
+  * factors of about the same size are multiplied and the asymptotically
+  * fast methods pay off; multiplying them one after another would cost
+  * quadratic time in the end.
+  *
+  * The operands are packed one after another into a single array. Runs of
+  * single digits are first collected into leaves of up to
+  * MBI_PRODUCT_LEAF digits by single digit multiplications. Every node
+  * keeps the place of its leaves in two buffers of the total input length,
+  * which the levels use in turns, so no memory is allocated per level.
+  */
+  
+  /* Single digits are collected into leaves of up to this many digits */
+  #ifndef MBI_PRODUCT_LEAF
+  #define MBI_PRODUCT_LEAF 16
+  #endif
+  
+  /*
+  * Returns the number of digits of a product of many numbers
+  * Remark: This is the sum of the lengths; lengths may be NULL, then there
+    are count single digits.
+  */
+  bigintlength mbiProductTreeSize( bigintlength count, const bigintlength* lengths )
+  {
+    if( lengths == NULL ) return count;
+    bigintlength s = 0;
+    for( bigintlength i = 0; i < count; i++ ) s += lengths[i];
+    return s;
+  }
+  
+  /*
+  * Builds the leaves of a product tree
+  * Remark: The operands are put into leaves, where node i has length[i]
+    significant digits at offset[i]; leaves has ProductTreeSize digits.
+    Returns the number of leaves, or 0 if an operand is zero.
+  */
+  bigintlength mbiProductTreeLeaves( bigintlength count, const bigint* operands, const bigintlength* lengths,
+                                     bigint* leaves, bigintlength* offset, bigintlength* length )
+  {
+    bigintlength nodes = 0, in = 0, out = 0;
+    
+    for( bigintlength i = 0; i < count; i++ )
+    {
+      bigintlength n = lengths == NULL ? 1 : lengths[i];
+      bigintlength l = n;
+      while( l > 0 && operands[in + l - 1] == 0 ) l--;
+      if( l == 0 ) return 0;
+      
+      if( l == 1 && nodes > 0 && length[nodes-1] < MBI_PRODUCT_LEAF ){
+        /* Collect the digit into the last leaf, whose room has grown by n */
+        bigint* z = leaves + offset[nodes-1];
+        bigint carry = mbiMulLimb( length[nodes-1], z, z, operands[in] );
+        if( carry != 0 ) z[length[nodes-1]++] = carry;
+      }else{
+        mbiCopy( l, leaves + out, operands + in );
+        offset[nodes] = out;
+        length[nodes] = l;
+        nodes++;
+      }
+      
+      in  += n;
+      out += n;
+    }
+    
+    return nodes;
+  }
+  
+  /*
+  * Multiplies many numbers
+  * Remark: operands holds count numbers one after another, the i-th one
+    with lengths[i] digits, or single digits if lengths is NULL. dest
+    points to ProductTreeSize digits and must not overlap with operands.
+    Returns the number of significant digits of the product. count must be
+    positive.
+  */
+  bigintlength mbiProductTree( bigint* dest, bigintlength count, const bigint* operands, const bigintlength* lengths )
+  {
+    
+    assert( count > 0 );
+    
+    bigintlength s = mbiProductTreeSize( count, lengths );
+    bigint* buffer = mbiAlloc( sizeof(bigint) * 2*s );
+    bigintlength* offset = mbiAlloc( sizeof(bigintlength) * 2*count );
+    bigintlength* length = offset + count;
+    assert( buffer != NULL && offset != NULL );
+    
+    bigint *from = buffer, *to = buffer + s;
+    bigint* scratch = NULL;
+    bigintlength scratchsize = 0;
+    
+    bigintlength nodes = mbiProductTreeLeaves( count, operands, lengths, from, offset, length );
+    bigintlength result = 0;
+    
+    if( nodes > 0 ){
+      
+      /* Multiply neighbours, node j of the next level takes the place of node 2j */
+      while( nodes > 1 )
+      {
+        bigintlength j;
+        for( j = 0; 2*j + 1 < nodes; j++ )
+        {
+          bigintlength o = offset[2*j], l1 = length[2*j], l2 = length[2*j+1];
+          
+          bigintlength need = mbiMultiplyUnbalancedScratchSize( l1, l2 );
+          if( need > scratchsize ){
+            mbiFree( scratch, sizeof(bigint) * scratchsize );
+            scratch = mbiAlloc( sizeof(bigint) * need );
+            assert( scratch != NULL );
+            scratchsize = need;
+          }
+          
+          mbiMultiplyUnbalancedScratch( to + o, l1, from + o, l2, from + offset[2*j+1], scratch );
+          
+          bigintlength l = l1 + l2;
+          while( to[o + l - 1] == 0 ) l--;
+          offset[j] = o;
+          length[j] = l;
+        }
+        if( 2*j < nodes ){
+          mbiCopy( length[2*j], to + offset[2*j], from + offset[2*j] );
+          offset[j] = offset[2*j];
+          length[j] = length[2*j];
+          j++;
+        }
+        nodes = j;
+        bigint* t = from; from = to; to = t;
+      }
+      
+      result = length[0];
+      mbiCopy( result, dest, from + offset[0] );
+    }
+    
+    mbiSetZero( s - result, dest + result );
+    
+    mbiFree( scratch, sizeof(bigint) * scratchsize );
+    mbiFree( offset, sizeof(bigintlength) * 2*count );
+    mbiFree( buffer, sizeof(bigint) * 2*s );
+    return result;
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Powers                                    */
+  /*********************************************/
+  
+  /*
+  * Returns the number of digits of a power
+  * Remark: base has n digits. The size is found from the numerical length
+    of the base, so it is exact up to one digit. At least one digit is
+    returned, for 0^0 = 1.
+  */
+  bigintlength mbiPowSize( bigintlength n, const bigint* base, unsigned long exponent )
+  {
+    bigintlength digits;
+    unsigned long bits;
+    mbiGetNumericalLength( n, base, &digits, &bits );
+    if( digits == 0 || exponent == 0 ) return 1;
+    
+    unsigned long total = ( digits - 1 ) * DIGIT_BITS + bits;
+    return ( total * exponent + DIGIT_BITS - 1 ) / DIGIT_BITS;
+  }
+  
+  /*
+  * Raises a Big Int to a power
+  * Remark: base has n digits, dest points to PowSize digits and must not
+    overlap with base. Returns the number of significant digits of the
+    result. Powers of two are shifts. Otherwise the exponent is processed
+    from left to right in sliding windows of up to w bits, with the odd
+    powers base^1, base^3, ..., base^{2^w - 1} computed beforehand; every
+    bit costs a square (SquareN) and every window one multiplication. The
+    intermediate results go back and forth between two buffers of the
+    final size.
+  */
+  bigintlength mbiPow( bigint* dest, bigintlength n, const bigint* base, unsigned long exponent )
+  {
+    
+    bigintlength size = mbiPowSize( n, base, exponent );
+    bigintlength nb;
+    unsigned long bits;
+    mbiGetNumericalLength( n, base, &nb, &bits );
+    
+    mbiSetZero( size, dest );
+    
+    if( exponent == 0 ){
+      dest[0] = 1;
+      return 1;
+    }
+    if( nb == 0 ) return 0;
+    
+    /* Powers of two */
+    if( mbiPopCount( nb, base ) == 1 ){
+      unsigned long s = mbiCountTrailingZeros( nb, base ) * exponent;
+      dest[s / DIGIT_BITS] = (bigint)1 << ( s % DIGIT_BITS );
+      return s / DIGIT_BITS + 1;
+    }
+    
+    /* Width of the windows */
+    unsigned int ebits = DIGIT_BITS - mbiDigitLeadingZeros( exponent );
+    unsigned int w = ebits <= 8 ? 1 : ebits <= 24 ? 2 : ebits <= 80 ? 3 : 4;
+    bigintlength odd = (bigintlength)1 << ( w - 1 );
+    
+    /* base^{2j+1} has at most (2j+1) nb digits */
+    bigintlength tablesize = odd * odd * nb;
+    bigintlength buffersize = size + 1;
+    bigintlength scratchsize = mbiMultiplyUnbalancedScratchSize( buffersize, buffersize );
+    if( mbiSquareNScratchSize( buffersize ) > scratchsize ) scratchsize = mbiSquareNScratchSize( buffersize );
+    
+    size_t bytes = sizeof(bigint) * ( tablesize + 2*nb + 2*buffersize + scratchsize );
+    bigint* memory = mbiAlloc( bytes );
+    assert( memory != NULL );
+    
+    bigint* table   = memory;
+    bigint* square  = table + tablesize;
+    bigint* from    = square + 2*nb;
+    bigint* to      = from + buffersize;
+    bigint* scratch = to + buffersize;
+    
+    bigintlength offset[8], length[8];
+    
+    /* The odd powers, base^{2j+1} = base^{2j-1} base^2 */
+    offset[0] = 0;
+    length[0] = nb;
+    mbiCopy( nb, table, base );
+    if( odd > 1 ){
+      bigintlength ls = 2*nb;
+      mbiSquareNScratch( nb, square, base, scratch );
+      while( square[ls-1] == 0 ) ls--;
+      for( bigintlength j = 1; j < odd; j++ )
+      {
+        offset[j] = offset[j-1] + ( 2*j - 1 ) * nb;
+        mbiMultiplyUnbalancedScratch( table + offset[j], length[j-1], table + offset[j-1], ls, square, scratch );
+        length[j] = length[j-1] + ls;
+        while( table[offset[j] + length[j] - 1] == 0 ) length[j]--;
+      }
+    }
+    
+    /* Left to right through the exponent */
+    bigintlength l = 0;
+    int i = (int)ebits - 1;
+    
+    while( i >= 0 )
+    {
+      
+      if( ( ( exponent >> i ) & 1 ) == 0 ){
+        mbiSquareNScratch( l, to, from, scratch );
+        l = 2*l;
+        while( to[l-1] == 0 ) l--;
+        bigint* t = from; from = to; to = t;
+        i--;
+        continue;
+      }
+      
+      /* The window ends with the lowest set bit of at most w bits */
+      int j = i - (int)w + 1;
+      if( j < 0 ) j = 0;
+      while( ( ( exponent >> j ) & 1 ) == 0 ) j++;
+      unsigned long value = ( exponent >> j ) & ( ( 1UL << ( i - j + 1 ) ) - 1 );
+      const bigint* factor = table + offset[value / 2];
+      bigintlength lf = length[value / 2];
+      
+      if( l == 0 ){
+        /* First window */
+        mbiCopy( lf, from, factor );
+        l = lf;
+      }else{
+        for( int s = i; s >= j; s-- )
+        {
+          mbiSquareNScratch( l, to, from, scratch );
+          l = 2*l;
+          while( to[l-1] == 0 ) l--;
+          bigint* t = from; from = to; to = t;
+        }
+        mbiMultiplyUnbalancedScratch( to, l, from, lf, factor, scratch );
+        l = l + lf;
+        while( to[l-1] == 0 ) l--;
+        bigint* t = from; from = to; to = t;
+      }
+      
+      i = j - 1;
+    }
+    
+    assert( l <= size );
+    mbiCopy( l, dest, from );
+    mbiFree( memory, bytes );
+    return l;
+  }
+  
+  /*
+  * Raises a handle to a power
+  * Remark: r = a^e, r may be the same handle as a.
+  */
+  void mbiNumPow( bigintnum* r, const bigintnum* a, unsigned long e )
+  {
+    bigintnum t;
+    mbiNumInit( &t, r->allocator );
+    
+    bigint zero = 0;
+    const bigint* base = a->length > 0 ? a->digits : &zero;
+    bigintlength n = a->length > 0 ? a->length : 1;
+    
+    mbiNumReserve( &t, mbiPowSize( n, base, e ) );
+    t.length   = mbiPow( t.digits, n, base, e );
+    t.negative = a->negative && ( e & 1 );
+    mbiNumNormalize( &t );
+    
+    mbiNumSwap( r, &t );
+    mbiNumFree( &t );
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Roots                                     */
+  /*********************************************/
+  
+  /*
+  * The k-th root of a is found without division. With R = ceil(N/k) for
+  * a of N bits, the root is 2^R / z for z = x^{-1/k}, x = a / 2^{kR}, and z
+  * is approximated by Newton's iteration
+  *
+  *   z' = z + z (1 - x z^k) / k,
+  *
+  * which only multiplies. Its precision doubles in every step, so the
+  * steps are done with the leading bits of x only, twice as many each
+  * time, and the last one dominates the cost. The iteration function is
+  * concave with its maximum at the root, so starting below z, taking x
+  * rounded up and rounding every step down keeps all iterates below z:
+  * 1 - x z^k is never negative. Finally, a * z^{k-1} gives the root up
+  * to a few units, which are corrected against the remainder.
+  */
+  
+  /*
+  * Roots of up to this many bits are found bit by bit, 40 for digits of 64
+  * bits. It is less than DIGIT_BITS, and 2^{2 MBI_ROOT_BOOTSTRAP} fits into
+  * two digits for the start value.
+  */
+  #define MBI_ROOT_BOOTSTRAP ( DIGIT_BITS/2 + 8 )
+  
+  /*
+  * Computes the k-th root of a handle bit by bit
+  * Remark: s = floor(a^{1/k}), where the root is known to be less than
+    2^bits and bits is at most DIGIT_BITS. Costs one power per bit, so
+    this is for small roots and the start value only.
+  */
+  void mbiNumRootSmall( bigintnum* s, const bigintnum* a, unsigned long k, unsigned long bits )
+  {
+    unsigned long n = mbiNumBits( a );
+    bigint root = 0;
+    bigintnum c, t;
+    mbiNumInit( &c, NULL );
+    mbiNumInit( &t, NULL );
+    
+    for( unsigned long b = bits; b > 0; b-- )
+    {
+      bigint candidate = root | ( (bigint)1 << ( b - 1 ) );
+      
+      /* candidate^k has at least (bits of candidate - 1) k + 1 bits */
+      unsigned long cb = DIGIT_BITS - mbiDigitLeadingZeros( candidate );
+      if( ( cb - 1 ) * k >= n ) continue;
+      
+      mbiNumSet( &c, 1, &candidate, false );
+      mbiNumPow( &t, &c, k );
+      if( mbiNumCompareAbs( &t, a ) <= 0 ) root = candidate;
+    }
+    
+    mbiNumSet( s, 1, &root, false );
+    mbiNumFree( &c );
+    mbiNumFree( &t );
+  }
+  
+  /*
+  * Computes the k-th root of a handle with remainder
+  * Remark: s = floor(a^{1/k}) and r = a - s^k, for a non-negative a and
+    k at least 1. r may be NULL. s and r must be different from a.
+  */
+  void mbiNumRootRem( bigintnum* s, bigintnum* r, const bigintnum* a, unsigned long k )
+  {
+    
+    assert( k >= 1 );
+    assert( !a->negative );
+    assert( s != a && r != a );
+    
+    unsigned long n = mbiNumBits( a );
+    unsigned long R = ( n + k - 1 ) / k;
+    
+    if( n == 0 ){
+      mbiNumSet( s, 0, NULL, false );
+      if( r != NULL ) mbiNumSet( r, 0, NULL, false );
+      return;
+    }
+    
+    bigintnum t, u;
+    mbiNumInit( &t, NULL );
+    mbiNumInit( &u, NULL );
+    
+    if( k == 1 ){
+      
+      mbiNumSet( s, a->length, a->digits, false );
+      
+    }else if( R <= MBI_ROOT_BOOTSTRAP ){
+      
+      mbiNumRootSmall( s, a, k, R );
+      
+    }else{
+      
+      bigintnum z, x, d;
+      mbiNumInit( &z, NULL );
+      mbiNumInit( &x, NULL );
+      mbiNumInit( &d, NULL );
+      
+      /* Guard bits against the rounding in each step */
+      unsigned long g = DIGIT_BITS - mbiDigitLeadingZeros( k + 1 ) + 2;
+      
+      /*
+      * Start value of B = MBI_ROOT_BOOTSTRAP bits from the root s0 of the
+      * leading bits, which is less than 2^B and at least 2^{B-1}:
+      * z0 = 2^{2B} / (s0 + 2) is below 2^B z with some room for the
+      * rounding of x.
+      */
+      unsigned long m = R - MBI_ROOT_BOOTSTRAP;
+      mbiNumShiftRight( &t, a, k * m, false );
+      mbiNumRootSmall( &u, &t, k, MBI_ROOT_BOOTSTRAP );
+      bigint rem;
+      bigint z0 = mbiDivDigits( (bigint)1 << ( 2*MBI_ROOT_BOOTSTRAP - DIGIT_BITS ), 0, u.digits[0] + 2, &rem );
+      mbiNumSet( &z, 1, &z0, false );
+      unsigned long p = MBI_ROOT_BOOTSTRAP;
+      
+      /* The precisions, from the last one down */
+      unsigned long P = R + g + 2;
+      unsigned long precision[64];
+      unsigned int steps = 0;
+      for( unsigned long q = P; q > p && steps < 64; )
+      {
+        precision[steps++] = q;
+        unsigned long next = q / 2 + g;
+        if( next >= q ) break;
+        q = next;
+      }
+      
+      while( steps > 0 )
+      {
+        unsigned long q = precision[--steps];
+        
+        /* x with q + g leading bits, rounded up */
+        unsigned long sh = n > q + g ? n - ( q + g ) : 0;
+        mbiNumShiftRight( &x, a, sh, true );
+        
+        /* d = 2^{kR + kp - sh} - x z^k */
+        mbiNumPow( &t, &z, k );
+        mbiNumMul( &u, &t, &x );
+        bigint one = 1;
+        mbiNumSet( &d, 1, &one, false );
+        mbiNumShiftLeft( &d, &d, k*R + k*p - sh );
+        mbiNumSub( &d, &d, &u );
+        assert( !d.negative );
+        
+        /* z = z 2^{q-p} + z d / (k 2^{p + kR + kp - sh - q}) */
+        mbiNumMul( &t, &z, &d );
+        mbiNumShiftRight( &t, &t, p + k*R + k*p - sh - q, false );
+        mbiNumDivLimb( &t, &t, k );
+        mbiNumShiftLeft( &z, &z, q - p );
+        mbiNumAdd( &z, &z, &t );
+        p = q;
+      }
+      
+      /* s = a z^{k-1} / 2^{(R+p)(k-1)}, at most the root */
+      mbiNumPow( &t, &z, k - 1 );
+      mbiNumMul( &u, &t, a );
+      mbiNumShiftRight( s, &u, ( R + p ) * ( k - 1 ), false );
+      
+      mbiNumFree( &z );
+      mbiNumFree( &x );
+      mbiNumFree( &d );
+      
+    }
+    
+    /* Correct the last units */
+    bigint one = 1;
+    bigintnum unit;
+    mbiNumInit( &unit, NULL );
+    mbiNumSet( &unit, 1, &one, false );
+    
+    mbiNumPow( &t, s, k );
+    while( mbiNumCompare( &t, a ) > 0 )
+    {
+      mbiNumSub( s, s, &unit );
+      mbiNumPow( &t, s, k );
+    }
+    for( ;; )
+    {
+      mbiNumAdd( &u, s, &unit );
+      mbiNumPow( &u, &u, k );
+      if( mbiNumCompare( &u, a ) > 0 ) break;
+      mbiNumAdd( s, s, &unit );
+      mbiNumSwap( &t, &u );
+    }
+    
+    if( r != NULL ) mbiNumSub( r, a, &t );
+    
+    mbiNumFree( &unit );
+    mbiNumFree( &t );
+    mbiNumFree( &u );
+  }
+  
+  /*
+  * Computes the k-th root of a Big Int with remainder
+  * Remark: a has n digits, root points to ceil(n/k) digits and receives
+    floor(a^{1/k}), rem points to n digits and receives a - root^k, or is
+    NULL. Returns the number of significant digits of the root. k must be
+    at least 1.
+  */
+  bigintlength mbiRootRem( bigint* root, bigint* rem, bigintlength n, const bigint* a, unsigned long k )
+  {
+    bigintnum x, s, r;
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &s, NULL );
+    mbiNumInit( &r, NULL );
+    
+    mbiNumSet( &x, n, a, false );
+    mbiNumRootRem( &s, rem != NULL ? &r : NULL, &x, k );
+    
+    bigintlength l = s.length;
+    bigintlength nr = ( n + k - 1 ) / k;
+    if( l > 0 ) mbiCopy( l, root, s.digits );
+    mbiSetZero( nr - l, root + l );
+    if( rem != NULL ){
+      if( r.length > 0 ) mbiCopy( r.length, rem, r.digits );
+      mbiSetZero( n - r.length, rem + r.length );
+    }
+    
+    mbiNumFree( &x );
+    mbiNumFree( &s );
+    mbiNumFree( &r );
+    return l;
+  }
+  
+  /*
+  * Computes the square root of a Big Int with remainder
+  * Remark: Works like RootRem with k = 2, i.e. root has ceil(n/2) digits.
+  */
+  bigintlength mbiSqrtRem( bigint* root, bigint* rem, bigintlength n, const bigint* a )
+  {
+    return mbiRootRem( root, rem, n, a, 2 );
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Division                                  */
+  /*********************************************/
+  
+  /*
+  * Divides two Big Ints according to school method
+  * Remark: a has n digits, b has m digits with b[m-1] != 0 and m <= n.
+    q points to n-m+1 digits and receives the quotient, r points to m
+    digits and receives the remainder; either may be NULL. This is Knuth's
+    algorithm D: the divisor is normalized so that its top bit is set, then
+    every quotient digit estimated from the leading digits is at most 2
+    too large and mostly exact.
+  */
+  void mbiDivRem( bigint* q, bigint* r, bigintlength n, const bigint* a, bigintlength m, const bigint* b )
+  {
+    
+    assert( m > 0 && m <= n && b[m-1] != 0 );
+    
+    size_t bytes = sizeof(bigint) * ( (n+1) + m );
+    bigint* u = mbiAlloc( bytes );
+    assert( u != NULL );
+    bigint* v = u + n+1;
+    
+    /* Normalize */
+    unsigned int s = mbiDigitLeadingZeros( b[m-1] );
+    mbiBitLeftShiftCopy( m, v, b, s );
+    mbiCopy( n, u, a );
+    u[n] = 0;
+    mbiBitLeftShift( n+1, u, s );
+    
+    /* All estimates divide by the same leading digit */
+    bigintreciprocal top;
+    mbiReciprocalInit( &top, v[m-1] );
+    
+    for( bigintlength j = n - m + 1; j > 0; j-- )
+    {
+      bigint* w = u + (j-1);
+      bigint qhat, rhat;
+      bool overflow;
+      
+      /* Estimate from the leading two digits, w[m] <= v[m-1] */
+      if( w[m] == v[m-1] ){
+        qhat = DIGIT_MAX;
+        rhat = w[m-1] + v[m-1];
+        overflow = rhat < v[m-1];
+      }else{
+        qhat = mbiDivDigitsPre( w[m], w[m-1], &top, &rhat );
+        overflow = false;
+      }
+      
+      /* Correct with the third digit */
+      while( m >= 2 && !overflow )
+      {
+        bigint hi, lo = mbiMulDigits( qhat, v[m-2], &hi );
+        if( hi < rhat || ( hi == rhat && lo <= w[m-2] ) ) break;
+        qhat--;
+        rhat += v[m-1];
+        overflow = rhat < v[m-1];
+      }
+      
+      /* Multiply and subtract, add back if it was one too large */
+      bigint borrow = mbiSubMulLimb( m, w, v, qhat );
+      bool negative = w[m] < borrow;
+      w[m] -= borrow;
+      if( negative ){
+        qhat--;
+        bool carry = false;
+        mbiAdd( m, w, v, &carry );
+        w[m] += carry;
+      }
+      
+      if( q != NULL ) q[j-1] = qhat;
+    }
+    
+    if( r != NULL ) mbiBitRightShiftCopy( m, r, u, s );
+    
+    mbiFree( u, bytes );
+  }
+  
+  /*
+  * Divides two handles
+  * Remark: q = a / b rounded towards zero and r = a - q b, which has the
+    sign of a. Either may be NULL, and q, r may be the same handles as a
+    or b. b must not be zero.
+  */
+  void mbiNumDivRem( bigintnum* q, bigintnum* r, const bigintnum* a, const bigintnum* b )
+  {
+    
+    assert( b->length > 0 );
+    
+    bigintnum tq, tr;
+    mbiNumInit( &tq, q != NULL ? q->allocator : NULL );
+    mbiNumInit( &tr, r != NULL ? r->allocator : NULL );
+    
+    if( a->length >= b->length ){
+      bigintlength n = a->length, m = b->length;
+      mbiNumReserve( &tq, n - m + 1 );
+      mbiNumReserve( &tr, m );
+      mbiDivRem( tq.digits, tr.digits, n, a->digits, m, b->digits );
+      tq.length   = n - m + 1;
+      tq.negative = a->negative != b->negative;
+      tr.length   = m;
+      tr.negative = a->negative;
+      mbiNumNormalize( &tq );
+      mbiNumNormalize( &tr );
+    }else{
+      mbiNumSet( &tr, a->length, a->digits, a->negative );
+    }
+    
+    if( q != NULL ) mbiNumSwap( q, &tq );
+    if( r != NULL ) mbiNumSwap( r, &tr );
+    mbiNumFree( &tq );
+    mbiNumFree( &tr );
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Special moduli                            */
+  /*********************************************/
+  
+  /*
+  * Residues modulo M = 2^p - c for a single digit 1 <= c <= 2^(p/2), as
+  * the Mersenne numbers 2^p - 1 of the Lucas-Lehmer test. With
+  * x = H 2^p + L, x is L + c H modulo M, so a product is reduced by
+  * folding its upper part onto the lower p bits: a shift, and an
+  * addition or a single row of MulLimb. As c is at most 2^(p/2), each
+  * fold removes at least p/2 bits until x is below 2^p + c, so a product
+  * of residues takes a handful of folds and a conditional subtraction
+  * once p spans a few digits. This makes the reduction linear instead of
+  * a division. For larger c the folds shrink x by only 2^p / c each, and
+  * mbiDivRem is the choice.
+  */
+  
+  /*
+  * Returns the number of digits of the residues modulo 2^p - c
+  * Remark: None
+  */
+  bigintlength mbiSpecialLength( unsigned long p )
+  {
+    return ( p + DIGIT_BITS - 1 ) / DIGIT_BITS;
+  }
+  
+  /*
+  * Returns the number of digits of scratch memory for ReduceSpecial
+  * Remark: The upper part of a product of 2n+1 digits.
+  */
+  bigintlength mbiReduceSpecialScratchSize( unsigned long p )
+  {
+    return 2*mbiSpecialLength( p ) + 1 - p / DIGIT_BITS;
+  }
+  
+  /*
+  * Returns whether c is small enough for the reductions modulo 2^p - c
+  * Remark: 1 <= c <= 2^(p/2).
+  */
+  bool mbiSpecialValid( unsigned long p, bigint c )
+  {
+    return c >= 1 && ( p / 2 >= DIGIT_BITS || c <= (bigint)1 << ( p / 2 ) );
+  }
+  
+  /*
+  * Returns whether a number has bits at position p or above
+  * Remark: x has len digits.
+  */
+  bool mbiSpecialHigh( unsigned long p, bigintlength len, const bigint* x )
+  {
+    bigintlength q = p / DIGIT_BITS;
+    unsigned int s = (unsigned int)( p % DIGIT_BITS );
+    if( q >= len ) return false;
+    if( ( x[q] >> s ) != 0 ) return true;
+    for( bigintlength i = q + 1; i < len; i++ )
+      if( x[i] != 0 ) return true;
+    return false;
+  }
+  
+  /*
+  * Reduces a number modulo 2^p - c
+  * Remark: x has len digits for n+1 <= len <= 2n+1 and n = SpecialLength(p),
+    e.g. a product of two residues and a digit of room. The residue is
+    left in the lower n digits and the digits above are zero. scratch
+    points to ReduceSpecialScratchSize(p) digits. c must be valid for p,
+    see SpecialValid. Each fold makes the number smaller, so it never
+    needs more than len digits.
+  */
+  void mbiReduceSpecial( unsigned long p, bigint c, bigintlength len, bigint* x, bigint* scratch )
+  {
+    
+    const bigintlength n = mbiSpecialLength( p );
+    const bigintlength q = p / DIGIT_BITS;
+    const unsigned int s = (unsigned int)( p % DIGIT_BITS );
+    
+    assert( mbiSpecialValid( p, c ) );
+    assert( len >= n + 1 && len <= 2*n + 1 );
+    
+    while( mbiSpecialHigh( p, len, x ) )
+    {
+      
+      /* H = x >> p, and x = L */
+      bigintlength hl = len - q;
+      mbiBitRightShiftCopy( hl, scratch, x + q, s );
+      while( hl > 0 && scratch[hl-1] == 0 ) hl--;
+      bigintlength keep = q;
+      if( s != 0 ) x[keep++] &= ( (bigint)1 << s ) - 1;
+      mbiSetZero( len - keep, x + keep );
+      
+      /* x = L + c H */
+      if( c == 1 ){
+        mbiAddInto( len, x, hl, scratch );
+      }else{
+        bigint carry = mbiAddMulLimb( hl, x, scratch, c );
+        mbiAddDigit( len - hl, x + hl, carry );
+      }
+      
+      while( len > n + 1 && x[len-1] == 0 ) len--;
+      
+    }
+    
+    /* x < 2^p now, subtract M if x + c reaches 2^p */
+    mbiAddDigit( n + 1, x, c );
+    if( ( x[q] >> s ) & 1 )
+      x[q] &= ~( (bigint)1 << s );
+    else
+      mbiSubDigit( n + 1, x, c );
+    
+  }
+  
+  /*
+  * Sets the residue modulo 2^p - c to 2^p - 1 - d
+  * Remark: x has n+1 digits, d < 2^p - c.
+  */
+  void mbiSpecialSetMinus( unsigned long p, bigint* x, bigint d )
+  {
+    const bigintlength n = mbiSpecialLength( p );
+    for( bigintlength i = 0; i < n; i++ ) x[i] = DIGIT_MAX;
+    if( p % DIGIT_BITS != 0 ) x[n-1] = ( (bigint)1 << ( p % DIGIT_BITS ) ) - 1;
+    x[n] = 0;
+    mbiSubDigit( n, x, d );
+  }
+  
+  /*
+  * Lucas-Lehmer test of 2^p - 1
+  * Remark: p is an odd prime. s = 4 is squared and decreased by 2 modulo
+    2^p - 1 for p - 2 times, and 2^p - 1 is prime if s ends up zero. Each
+    iteration is one SquareN and the linear reduction, and all of them work
+    in two buffers of 2n+1 digits which are allocated once, together with
+    the scratch memory.
+  */
+  bool mbiLucasLehmer( unsigned long p )
+  {
+    
+    assert( p >= 3 && p % 2 == 1 );
+    
+    const bigintlength n = mbiSpecialLength( p );
+    const bigintlength ss = mbiSquareNScratchSize( n );
+    const bigintlength rs = mbiReduceSpecialScratchSize( p );
+    const bigintlength size = 2*( 2*n + 1 ) + ( ss > rs ? ss : rs );
+    
+    bigint* memory = mbiAlloc( sizeof(bigint) * size );
+    assert( memory != NULL );
+    bigint *a = memory, *b = memory + 2*n + 1, *scratch = memory + 2*( 2*n + 1 );
+    
+    mbiSetZero( n, a );
+    a[0] = 4;
+    
+    for( unsigned long i = 0; i + 2 < p; i++ )
+    {
+      mbiSquareNScratch( n, b, a, scratch );
+      b[2*n] = 0;
+      mbiReduceSpecial( p, 1, 2*n + 1, b, scratch );
+      
+      /* s - 2, which wraps around only for s < 2 */
+      if( b[0] < 2 && mbiIsZero( n - 1, b + 1 ) )
+        mbiSpecialSetMinus( p, b, 2 - b[0] );
+      else
+        mbiSubDigit( n, b, 2 );
+      
+      bigint* t = a; a = b; b = t;
+    }
+    
+    bool prime = mbiIsZero( n, a );
+    mbiFree( memory, sizeof(bigint) * size );
+    return prime;
+  }
+  
+  /*
+  * Fermat test of 2^p - c to the base a
+  * Remark: Returns whether a^(M-1) is 1 modulo M = 2^p - c, which holds for
+    primes M not dividing a; c must be valid for p, see SpecialValid. The
+    exponent M - 1 = 2^p - 1 - c has its upper p/2 bits set, so this is
+    p - 1 squarings, most of them followed by a multiplication by a, which
+    is a single row, in the same buffers as LucasLehmer.
+  */
+  bool mbiFermatSpecial( unsigned long p, bigint c, bigint a )
+  {
+    
+    assert( p >= 3 && mbiSpecialValid( p, c ) );
+    
+    const bigintlength n = mbiSpecialLength( p );
+    const bigintlength ss = mbiSquareNScratchSize( n );
+    const bigintlength rs = mbiReduceSpecialScratchSize( p );
+    const bigintlength size = 2*( 2*n + 1 ) + ( ss > rs ? ss : rs ) + n + 1;
+    
+    bigint* memory = mbiAlloc( sizeof(bigint) * size );
+    assert( memory != NULL );
+    bigint *x = memory, *y = memory + 2*n + 1, *e = memory + 2*( 2*n + 1 ), *scratch = e + n + 1;
+    
+    /* e = M - 1 = 2^p - 1 - c */
+    mbiSpecialSetMinus( p, e, c );
+    
+    /* the top bit p-1 of e is set, so x starts with a mod M */
+    mbiSetZero( n + 1, x );
+    x[0] = a;
+    mbiReduceSpecial( p, c, n + 1, x, scratch );
+    
+    for( unsigned long i = p - 1; i-- > 0; )
+    {
+      mbiSquareNScratch( n, y, x, scratch );
+      y[2*n] = 0;
+      mbiReduceSpecial( p, c, 2*n + 1, y, scratch );
+      
+      if( ( e[i / DIGIT_BITS] >> ( i % DIGIT_BITS ) ) & 1 ){
+        y[n] = mbiMulLimb( n, y, y, a );
+        mbiReduceSpecial( p, c, n + 1, y, scratch );
+      }
+      
+      bigint* t = x; x = y; y = t;
+    }
+    
+    bool one = x[0] == 1 && mbiIsZero( n - 1, x + 1 );
+    mbiFree( memory, sizeof(bigint) * size );
+    return one;
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Greatest common divisors                  */
+  /*********************************************/
+  
+  /*
+  * The gcd is found by reducing a pair (a, b) with steps a -= q b or
+  * b -= q a. They are collected in a 2x2 matrix M of non-negative entries
+  * and determinant 1 with (a, b) = M (a', b'), which gives the cofactors
+  * of the extended gcd in the end.
+  *
+  * A reduction with threshold S only takes steps that leave both numbers
+  * at least 2^S. If it is computed from the leading bits a >> p, b >> p
+  * with threshold T >= (bits + 1) / 2 and T - 1 + p >= S, its matrix is a
+  * valid reduction of (a, b) with threshold S as well: the entries of M
+  * are then less than 2^(bits-T) <= 2^(T-1), so the neglected low parts
+  * change a' and b' by less than half of their leading parts.
+  *
+  * Lehmer's method does this for a window of the leading two digits, so
+  * a step of single digit cofactors costs two limb multiplications of the
+  * numbers. The half-gcd reduces the leading half of the bits recursively
+  * twice, each time a quarter of the total, and applies the matrices with
+  * fast multiplications, which costs O(M(n) log n). Single digits are left
+  * to the binary method.
+  */
+  
+  /* Numbers of up to this many digits go to the binary gcd */
+  #ifndef MBI_GCD_BINARY
+  #define MBI_GCD_BINARY 1
+  #endif
+  
+  /* Reductions of at least this many digits are done by the half-gcd */
+  #ifndef MBI_HGCD_THRESHOLD
+  #define MBI_HGCD_THRESHOLD 64
+  #endif
+  
+  /* Numbers of at least this many digits are reduced by the half-gcd */
+  #ifndef MBI_GCD_HGCD
+  #define MBI_GCD_HGCD 1024
+  #endif
+  
+  /* The window of the leading bits for Lehmer's steps */
+  #if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 bigintwindow;
+    #define MBI_GCD_WINDOW ( 2 * DIGIT_BITS )
+  #else
+    typedef bigint bigintwindow;
+    #define MBI_GCD_WINDOW DIGIT_BITS
+  #endif
+  
+  typedef struct {
+    bigintnum m[2][2];
+  } bigintmatrix;
+  
+  /*
+  * Initializes a matrix of handles to the identity
+  */
+  void mbiMatrixInit( bigintmatrix* M )
+  {
+    bigint one = 1;
+    for( int i = 0; i < 2; i++ )
+      for( int j = 0; j < 2; j++ )
+      {
+        mbiNumInit( &M->m[i][j], NULL );
+        if( i == j ) mbiNumSet( &M->m[i][j], 1, &one, false );
+      }
+  }
+  
+  /*
+  * Releases a matrix of handles
+  */
+  void mbiMatrixFree( bigintmatrix* M )
+  {
+    for( int i = 0; i < 2; i++ )
+      for( int j = 0; j < 2; j++ )
+        mbiNumFree( &M->m[i][j] );
+  }
+  
+  /*
+  * Multiplies a matrix of handles by another one
+  * Remark: M = M H.
+  */
+  void mbiMatrixMul( bigintmatrix* M, const bigintmatrix* H )
+  {
+    bigintnum t, u;
+    mbiNumInit( &t, NULL );
+    mbiNumInit( &u, NULL );
+    
+    for( int i = 0; i < 2; i++ )
+    {
+      mbiNumMul( &t, &M->m[i][0], &H->m[0][0] );
+      mbiNumMul( &u, &M->m[i][1], &H->m[1][0] );
+      mbiNumAdd( &t, &t, &u );
+      mbiNumMul( &u, &M->m[i][0], &H->m[0][1] );
+      mbiNumMul( &M->m[i][1], &M->m[i][1], &H->m[1][1] );
+      mbiNumAdd( &M->m[i][1], &M->m[i][1], &u );
+      mbiNumSwap( &M->m[i][0], &t );
+    }
+    
+    mbiNumFree( &t );
+    mbiNumFree( &u );
+  }
+  
+  /*
+  * Applies the inverse of a matrix of handles to a pair
+  * Remark: (a, b) = H^-1 (a, b) = (h11 a - h01 b, h00 b - h10 a), where H
+    is a reduction of (a, b), so both results are non-negative.
+  */
+  void mbiMatrixApply( const bigintmatrix* H, bigintnum* a, bigintnum* b )
+  {
+    bigintnum t, u;
+    mbiNumInit( &t, NULL );
+    mbiNumInit( &u, NULL );
+    
+    mbiNumMul( &t, &H->m[1][1], a );
+    mbiNumMul( &u, &H->m[0][1], b );
+    mbiNumSub( &t, &t, &u );
+    mbiNumMul( b, &H->m[0][0], b );
+    mbiNumMul( &u, &H->m[1][0], a );
+    mbiNumSub( b, b, &u );
+    mbiNumSwap( a, &t );
+    assert( !a->negative && !b->negative );
+    
+    mbiNumFree( &t );
+    mbiNumFree( &u );
+  }
+  
+  /*
+  * Computes a linear combination of two handles with single digit factors
+  * Remark: r = x a + y b, or x a - y b if subtract is true, which must not
+    be negative then. a and b are non-negative and r is different from
+    both.
+  */
+  void mbiNumLinear( bigintnum* r, bigint x, const bigintnum* a, bigint y, const bigintnum* b, bool subtract )
+  {
+    bigintlength n = ( a->length > b->length ? a->length : b->length ) + 2;
+    size_t bytes = sizeof(bigint) * n;
+    bigint* t = mbiAlloc( bytes );
+    assert( t != NULL );
+    
+    mbiNumReserve( r, n );
+    mbiSetZero( n, r->digits );
+    mbiSetZero( n, t );
+    if( a->length > 0 ) r->digits[a->length] = mbiMulLimb( a->length, r->digits, a->digits, x );
+    if( b->length > 0 ) t[b->length] = mbiMulLimb( b->length, t, b->digits, y );
+    
+    bool carry = false;
+    if( subtract ) mbiSub( n, r->digits, t, &carry );
+    else mbiAdd( n, r->digits, t, &carry );
+    assert( !carry );
+    
+    r->length   = n;
+    r->negative = false;
+    mbiNumNormalize( r );
+    mbiFree( t, bytes );
+  }
+  
+  /*
+  * Reads the window of the leading bits of a handle
+  * Remark: Returns the bits of the absolute value from position sh on,
+    which must fit into the window.
+  */
+  bigintwindow mbiGcdWindow( const bigintnum* x, unsigned long sh )
+  {
+    bigintlength i = sh / DIGIT_BITS;
+    unsigned int r = sh % DIGIT_BITS;
+    bigintwindow w = 0;
+    
+    for( bigintlength k = 0; k <= MBI_GCD_WINDOW / DIGIT_BITS && i + k < x->length; k++ )
+    {
+      bigint d = x->digits[i+k];
+      if( k == 0 ) w = d >> r;
+      else if( k * DIGIT_BITS - r < MBI_GCD_WINDOW ) w |= (bigintwindow)d << ( k * DIGIT_BITS - r );
+    }
+    
+    return w;
+  }
+  
+  /*
+  * Reduces the window of two numbers
+  * Remark: x and y are at least 2^T, and stay so. The steps are collected
+    in m, whose entries are less than 2^(MBI_GCD_WINDOW - T). Returns
+    whether there was any step.
+  */
+  bool mbiGcdReduceWindow( bigintwindow x, bigintwindow y, unsigned long T, bigint m[2][2] )
+  {
+    const bigintwindow bound = (bigintwindow)1 << T;
+    bool progress = false;
+    
+    m[0][0] = m[1][1] = 1;
+    m[0][1] = m[1][0] = 0;
+    
+    for( ;; )
+    {
+      if( x >= y ){
+        bigint q = (bigint)( ( x - bound ) / y );
+        if( q == 0 ) break;
+        x -= q * y;
+        m[0][1] += q * m[0][0];
+        m[1][1] += q * m[1][0];
+      }else{
+        bigint q = (bigint)( ( y - bound ) / x );
+        if( q == 0 ) break;
+        y -= q * x;
+        m[0][0] += q * m[0][1];
+        m[1][0] += q * m[1][1];
+      }
+      progress = true;
+    }
+    
+    return progress;
+  }
+  
+  /*
+  * Subtracts a multiple of one handle from another, keeping it at least 2^S
+  * Remark: a -= q b for the largest q with a - q b >= 2^S, and the step is
+    collected in M (if not NULL). Returns whether q was not zero. Without
+    threshold (S < 0), a is replaced by a mod b.
+  */
+  bool mbiGcdDivStep( bigintnum* a, const bigintnum* b, long S, bigintmatrix* M, int column )
+  {
+    bigintnum q, bound;
+    mbiNumInit( &q, NULL );
+    mbiNumInit( &bound, NULL );
+    
+    if( S >= 0 ){
+      bigint one = 1;
+      mbiNumSet( &bound, 1, &one, false );
+      mbiNumShiftLeft( &bound, &bound, (unsigned long)S );
+      mbiNumSub( a, a, &bound );
+    }
+    mbiNumDivRem( &q, a, a, b );
+    mbiNumAdd( a, a, &bound );
+    
+    bool progress = q.length > 0;
+    if( progress && M != NULL ){
+      for( int i = 0; i < 2; i++ )
+      {
+        mbiNumMul( &bound, &q, &M->m[i][1-column] );
+        mbiNumAdd( &M->m[i][column], &M->m[i][column], &bound );
+      }
+    }
+    
+    mbiNumFree( &q );
+    mbiNumFree( &bound );
+    return progress;
+  }
+  
+  /*
+  * Takes one step of Lehmer's reduction with threshold S
+  * Remark: a and b are non-negative and the step is collected in M (if
+    not NULL). Returns false if no step keeps both at least 2^S.
+  */
+  bool mbiGcdStep( bigintnum* a, bigintnum* b, unsigned long S, bigintmatrix* M )
+  {
+    unsigned long na = mbiNumBits( a ), nb = mbiNumBits( b );
+    if( na <= S || nb <= S ) return false;
+    
+    unsigned long n = na > nb ? na : nb;
+    unsigned long sh = n > MBI_GCD_WINDOW ? n - MBI_GCD_WINDOW : 0;
+    unsigned long T = S;
+    if( sh == 0 && n > DIGIT_BITS - 1 && T < n - ( DIGIT_BITS - 1 ) ){
+      /* Exact, but the cofactors must fit into digits */
+      T = n - ( DIGIT_BITS - 1 );
+    }else if( sh > 0 ){
+      T = S + 1 > sh ? S + 1 - sh : 0;
+      if( T < MBI_GCD_WINDOW / 2 + 1 ) T = MBI_GCD_WINDOW / 2 + 1;
+    }
+    
+    if( T < MBI_GCD_WINDOW ){
+      bigintwindow x = mbiGcdWindow( a, sh ), y = mbiGcdWindow( b, sh );
+      bigintwindow bound = (bigintwindow)1 << T;
+      bigint m[2][2];
+      
+      if( x >= bound && y >= bound && mbiGcdReduceWindow( x, y, T, m ) ){
+        bigintnum t, u;
+        mbiNumInit( &t, NULL );
+        mbiNumInit( &u, NULL );
+        
+        mbiNumLinear( &t, m[1][1], a, m[0][1], b, true );
+        mbiNumLinear( &u, m[0][0], b, m[1][0], a, true );
+        mbiNumSwap( a, &t );
+        mbiNumSwap( b, &u );
+        
+        if( M != NULL ){
+          for( int i = 0; i < 2; i++ )
+          {
+            mbiNumLinear( &t, m[0][0], &M->m[i][0], m[1][0], &M->m[i][1], false );
+            mbiNumLinear( &u, m[0][1], &M->m[i][0], m[1][1], &M->m[i][1], false );
+            mbiNumSwap( &M->m[i][0], &t );
+            mbiNumSwap( &M->m[i][1], &u );
+          }
+        }
+        
+        mbiNumFree( &t );
+        mbiNumFree( &u );
+        return true;
+      }
+    }
+    
+    /* The window is too unbalanced or too close, divide the numbers */
+    if( mbiNumCompareAbs( a, b ) >= 0 ) return mbiGcdDivStep( a, b, (long)S, M, 1 );
+    return mbiGcdDivStep( b, a, (long)S, M, 0 );
+  }
+  
+  /*
+  * Reduces two handles by the half-gcd
+  * Remark: a and b are non-negative and are reduced with threshold S
+    until no further step is possible; the steps are collected in M, which
+    is initialized by the caller and set here. S should be at least half
+    the bits of a and b. Returns whether there was any step.
+  */
+  bool mbiHgcd( bigintnum* a, bigintnum* b, unsigned long S, bigintmatrix* M )
+  {
+    bigint one = 1;
+    for( int i = 0; i < 2; i++ )
+      for( int j = 0; j < 2; j++ )
+        mbiNumSet( &M->m[i][j], i == j, &one, false );
+    
+    unsigned long na = mbiNumBits( a ), nb = mbiNumBits( b );
+    unsigned long n = na > nb ? na : nb;
+    bool progress = false;
+    
+    if( na <= S || nb <= S ) return false;
+    
+    if( n - S < MBI_HGCD_THRESHOLD * DIGIT_BITS ){
+      while( mbiGcdStep( a, b, S, M ) ) progress = true;
+      return progress;
+    }
+    
+    bigintmatrix H;
+    bigintnum x, y;
+    mbiMatrixInit( &H );
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &y, NULL );
+    
+    /* Reduce the leading n - S bits by about half */
+    unsigned long h = n - S;
+    mbiNumShiftRight( &x, a, S, false );
+    mbiNumShiftRight( &y, b, S, false );
+    if( mbiHgcd( &x, &y, h / 2 + 1, &H ) ){
+      mbiMatrixApply( &H, a, b );
+      mbiMatrixMul( M, &H );
+      progress = true;
+    }
+    
+    /* Lehmer steps down to about S + h/2 bits, unless no step is left */
+    bool done = false;
+    for( ;; )
     {
-      for( j = 0; j < length; j++ ){
-        
-        long long w1, w2, w3;
-        bool carry  = false;
-        
-        w1 = a[i];
-        w2 = b[j];
-        w3 = w1*w2;
-        
-        /*
-        * If the rest of the code works properly
-        * we can use the following line
-        * without fear of memory corruption
-        */
-        mbiAdd( 2, p+(i+j), (bigint*)&w3, &carry );
-        if(carry) overflows[i+j+2]++;
-        
+      na = mbiNumBits( a );
+      nb = mbiNumBits( b );
+      n = na > nb ? na : nb;
+      if( n <= S + h / 2 ) break;
+      if( !mbiGcdStep( a, b, S, M ) ){
+        done = true;
+        break;
       }
+      progress = true;
     }
     
-    /* evaluate the carries */
-    bool carry = false;
-    mbiAdd( 2*length, p, overflows, &carry );
-    assert(!carry);
+    /* Reduce the rest from the leading 2 (n - S) bits */
+    if( !done && n < 2*S + 1 && n - S >= MBI_HGCD_THRESHOLD * DIGIT_BITS / 2 ){
+      unsigned long p = 2*S + 1 - n;
+      mbiNumShiftRight( &x, a, p, false );
+      mbiNumShiftRight( &y, b, p, false );
+      if( mbiHgcd( &x, &y, n - S, &H ) ){
+        mbiMatrixApply( &H, a, b );
+        mbiMatrixMul( M, &H );
+        progress = true;
+      }
+    }
     
-    free( overflows );
+    while( !done && mbiGcdStep( a, b, S, M ) ) progress = true;
     
+    mbiMatrixFree( &H );
+    mbiNumFree( &x );
+    mbiNumFree( &y );
+    return progress;
   }
- 
- 
+  
   /*
-  * Multiplies to Big ints of size <= 128 according to basic school method
-  * Remarks: Works like a NaivMultiplication, but it has been optimized
-    for and is restricted to the case of k <= 7. Could be even more sped-up
-    by using uchars for the overflows
+  * Computes the gcd of two Big Ints by the binary method
+  * Remark: x and y have n digits, are not zero and are overwritten; the
+    gcd is written to x. Halving and subtracting only, which is fast for
+    small numbers.
   */
-  void mbiNaivMultiplicationRestricted( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  void mbiGcdBinary( bigintlength n, bigint* x, bigint* y )
   {
+    bigint* g = x;
+    unsigned long zx = mbiCountTrailingZeros( n, x ), zy = mbiCountTrailingZeros( n, y );
+    unsigned long k = zx < zy ? zx : zy;
+    mbiBitRightShift( n, x, zx, true );
+    mbiBitRightShift( n, y, zy, true );
     
-    assert( k <= 7 );
-    bigintlength i, j;
-    bigintlength length = 1 << k;
-    assert( length <= 128 );
+    /* Both are odd, their difference is even */
+    for( ;; )
+    {
+      int c = mbiCompare( n, x, y );
+      if( c == 0 ) break;
+      if( c < 0 ){
+        bigint* t = x;
+        x = y;
+        y = t;
+      }
+      bool carry = false;
+      mbiSub( n, x, y, &carry );
+      mbiBitRightShift( n, x, mbiCountTrailingZeros( n, x ), true );
+    }
     
-    mbiSetZero( length*2, p );
+    /* Both arrays hold the odd part now */
+    mbiBitLeftShift( n, g, k );
+  }
+  
+  /*
+  * Computes the gcd and the cofactors of two handles
+  * Remark: g = gcd(a, b) = s a + t b, which is non-negative. s and t may
+    be NULL; otherwise |s| <= |b| / g and |t| <= |a| / g unless a or b is
+    zero. g, s and t must be different from a and b.
+  */
+  void mbiNumGcdExt( bigintnum* g, bigintnum* s, bigintnum* t, const bigintnum* a, const bigintnum* b )
+  {
+    bool extended = s != NULL || t != NULL;
+    bigintnum x, y;
+    bigintmatrix M, H;
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &y, NULL );
+    mbiMatrixInit( &M );
+    mbiMatrixInit( &H );
+    mbiNumSet( &x, a->length, a->digits, false );
+    mbiNumSet( &y, b->length, b->digits, false );
     
-    /* Collect the carries and add them later */
-    bigint overflows[256];
-    mbiSetZero( length*2, overflows );
+    /* (|a|, |b|) = M (x, y) */
+    bigintmatrix* P = extended ? &M : NULL;
     
-    /* main part */
-    for( i = 0; i < length; i++ )
+    while( x.length > 0 && y.length > 0 )
     {
-      for( j = 0; j < length; j++ ){
-        
-        long long w1, w2, w3;
-        bool carry  = false;
-        
-        w1 = a[i];
-        w2 = b[j];
-        w3 = w1*w2;
-        
-        /*
-        * If the rest of the code works properly
-        * we can use the following line
-        * without fear of memory corruption
-        */
-        mbiAdd( 2, p+(i+j), (bigint*)&w3, &carry );
-        if(carry) overflows[i+j+2]++;
-        
+      bigintlength nx = x.length, ny = y.length;
+      bigintlength n = nx > ny ? nx : ny;
+      
+      if( !extended && n <= MBI_GCD_BINARY ){
+        mbiNumReserve( &x, n );
+        mbiNumReserve( &y, n );
+        mbiSetZero( n - nx, x.digits + nx );
+        mbiSetZero( n - ny, y.digits + ny );
+        mbiGcdBinary( n, x.digits, y.digits );
+        x.length = n;
+        mbiNumNormalize( &x );
+        y.length = 0;
+        break;
+      }
+      
+      /* Far apart, one division does more than any reduction */
+      if( nx > ny + 1 ){
+        mbiGcdDivStep( &x, &y, -1, P, 1 );
+        continue;
+      }
+      if( ny > nx + 1 ){
+        mbiGcdDivStep( &y, &x, -1, P, 0 );
+        continue;
+      }
+      
+      if( n >= MBI_GCD_HGCD ){
+        unsigned long bits = mbiNumBits( nx > ny ? &x : &y );
+        if( mbiHgcd( &x, &y, bits / 2 + 1, &H ) ){
+          if( extended ) mbiMatrixMul( &M, &H );
+          continue;
+        }
       }
+      
+      if( mbiGcdStep( &x, &y, 0, P ) ) continue;
+      
+      if( mbiNumCompareAbs( &x, &y ) >= 0 ) mbiGcdDivStep( &x, &y, -1, P, 1 );
+      else mbiGcdDivStep( &y, &x, -1, P, 0 );
     }
     
-    /* evaluate the carries */
-    bool carry = false;
-    mbiAdd( 2*length, p, overflows, &carry );
-    assert(!carry);
+    /*
+    * With y = 0 the gcd is x = m11 |a| - m01 |b|, with x = 0 it is
+    * y = m00 |b| - m10 |a|.
+    */
+    bool first = y.length == 0;
+    if( s != NULL ){
+      mbiNumSwap( s, first ? &M.m[1][1] : &M.m[1][0] );
+      s->negative = ( s->length > 0 ) && ( a->negative != !first );
+    }
+    if( t != NULL ){
+      mbiNumSwap( t, first ? &M.m[0][1] : &M.m[0][0] );
+      t->negative = ( t->length > 0 ) && ( b->negative != first );
+    }
+    mbiNumSwap( g, first ? &x : &y );
     
+    mbiNumFree( &x );
+    mbiNumFree( &y );
+    mbiMatrixFree( &M );
+    mbiMatrixFree( &H );
   }
   
+  /*
+  * Computes the gcd of two handles
+  * Remark: g = gcd(a, b), which is non-negative. g must be different from
+    a and b.
+  */
+  void mbiNumGcd( bigintnum* g, const bigintnum* a, const bigintnum* b )
+  {
+    mbiNumGcdExt( g, NULL, NULL, a, b );
+  }
   
+  /*
+  * Computes the gcd of two Big Ints
+  * Remark: a has n1 and b has n2 digits, g points to max(n1, n2) digits.
+    Returns the number of significant digits of the gcd.
+  */
+  bigintlength mbiGcd( bigint* g, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    bigintnum x, y, r;
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &y, NULL );
+    mbiNumInit( &r, NULL );
+    
+    mbiNumSet( &x, n1, a, false );
+    mbiNumSet( &y, n2, b, false );
+    mbiNumNormalize( &x );
+    mbiNumNormalize( &y );
+    mbiNumGcd( &r, &x, &y );
+    
+    bigintlength l = r.length;
+    if( l > 0 ) mbiCopy( l, g, r.digits );
+    mbiSetZero( ( n1 > n2 ? n1 : n2 ) - l, g + l );
+    
+    mbiNumFree( &x );
+    mbiNumFree( &y );
+    mbiNumFree( &r );
+    return l;
+  }
   
- 
+  /*
+  * Computes the gcd and the cofactors of two Big Ints
+  * Remark: a has n1 and b has n2 digits, g points to max(n1, n2) digits,
+    s to n2 and t to n1 digits. Then g = s a + t b, where the signs of s and
+    t are written to sneg and tneg. Returns the number of significant
+    digits of the gcd.
+  */
+  bigintlength mbiGcdExt( bigint* g, bigint* s, bool* sneg, bigint* t, bool* tneg, bigintlength n1, const bigint* a, bigintlength n2, const bigint* b )
+  {
+    bigintnum x, y, r, u, v;
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &y, NULL );
+    mbiNumInit( &r, NULL );
+    mbiNumInit( &u, NULL );
+    mbiNumInit( &v, NULL );
+    
+    mbiNumSet( &x, n1, a, false );
+    mbiNumSet( &y, n2, b, false );
+    mbiNumNormalize( &x );
+    mbiNumNormalize( &y );
+    mbiNumGcdExt( &r, &u, &v, &x, &y );
+    assert( u.length <= n2 && v.length <= n1 );
+    
+    bigintlength l = r.length;
+    if( l > 0 ) mbiCopy( l, g, r.digits );
+    mbiSetZero( ( n1 > n2 ? n1 : n2 ) - l, g + l );
+    if( u.length > 0 ) mbiCopy( u.length, s, u.digits );
+    mbiSetZero( n2 - u.length, s + u.length );
+    if( v.length > 0 ) mbiCopy( v.length, t, v.digits );
+    mbiSetZero( n1 - v.length, t + v.length );
+    *sneg = u.negative;
+    *tneg = v.negative;
+    
+    mbiNumFree( &x );
+    mbiNumFree( &y );
+    mbiNumFree( &r );
+    mbiNumFree( &u );
+    mbiNumFree( &v );
+    return l;
+  }
+  
+  
+  
+  
+  /*********************************************/
+  /* Floating point numbers                    */
+  /*********************************************/
+  
+  /*
+  * A float keeps a mantissa handle and an exponent in digits, its value is
+  * mant * B^expo for B = 2^DIGIT_BITS, and a precision of prec digits. The
+  * mantissa never has more than prec digits; results are truncated towards
+  * zero. Products only compute the digits that survive the truncation: for
+  * operands of at least prec+1 digits that is the upper half of the product
+  * by MulHi instead of the full product.
+  *
+  * The precision belongs to each float and may be changed at any time, so
+  * Newton iterations can raise it step by step and run the early steps at
+  * low precision. Division and square root work that way, via the inverse
+  * and the inverse square root. Their results are not rounded correctly,
+  * the error is a few units of the last digit.
+  */
+  
+  typedef struct {
+    bigintnum mant;
+    long expo;
+    bigintlength prec;
+  } bigintfloat;
+  
+  
+  /*
+  * Initializes a float with the value zero
+  * Remark: prec is the precision in digits and at least 1, allocator may
+    be NULL like for handles.
+  */
+  void mbiFloatInit( bigintfloat* x, bigintlength prec, const bigintallocator* allocator )
+  {
+    assert( prec > 0 );
+    mbiNumInit( &x->mant, allocator );
+    x->expo = 0;
+    x->prec = prec;
+  }
+  
+  /*
+  * Frees the memory of a float
+  * Remark: The float is zero afterwards and may be used again.
+  */
+  void mbiFloatFree( bigintfloat* x )
+  {
+    mbiNumFree( &x->mant );
+    x->expo = 0;
+  }
+  
+  /*
+  * Exchanges the contents of two floats
+  * Remark: The precisions are exchanged as well.
+  */
+  void mbiFloatSwap( bigintfloat* x, bigintfloat* y )
+  {
+    bigintfloat t = *x;
+    *x = *y;
+    *y = t;
+  }
+  
+  /*
+  * Normalizes a float
+  * Remark: Truncates the mantissa to prec digits and drops its trailing
+    zero digits, so short values like 1 stay short.
+  */
+  void mbiFloatNormalize( bigintfloat* x )
+  {
+    bigintnum* m = &x->mant;
+    mbiNumNormalize( m );
+    if( m->length == 0 ){
+      x->expo = 0;
+      return;
+    }
+    
+    bigintlength d = m->length > x->prec ? m->length - x->prec : 0;
+    while( d < m->length && m->digits[d] == 0 ) d++;
+    if( d > 0 ){
+      mbiNumShiftRight( m, m, d * DIGIT_BITS, false );
+      x->expo += (long)d;
+    }
+  }
+  
+  /*
+  * Changes the precision of a float
+  * Remark: The value is truncated if the precision decreases.
+  */
+  void mbiFloatSetPrecision( bigintfloat* x, bigintlength prec )
+  {
+    assert( prec > 0 );
+    x->prec = prec;
+    mbiFloatNormalize( x );
+  }
+  
+  /*
+  * Sets a float to another one
+  * Remark: The value of a is truncated to the precision of r, which may be
+    the same float as a.
+  */
+  void mbiFloatSet( bigintfloat* r, const bigintfloat* a )
+  {
+    mbiNumSet( &r->mant, a->mant.length, a->mant.digits, a->mant.negative );
+    r->expo = a->expo;
+    mbiFloatNormalize( r );
+  }
+  
+  /*
+  * Sets a float to an integer
+  * Remark: The value is truncated to the precision of x.
+  */
+  void mbiFloatSetNum( bigintfloat* x, const bigintnum* a )
+  {
+    mbiNumSet( &x->mant, a->length, a->digits, a->negative );
+    x->expo = 0;
+    mbiFloatNormalize( x );
+  }
+  
+  /*
+  * Sets a float to a single digit
+  * Remark: None
+  */
+  void mbiFloatSetDigit( bigintfloat* x, bigint d, bool negative )
+  {
+    mbiNumSet( &x->mant, 1, &d, negative );
+    x->expo = 0;
+    mbiFloatNormalize( x );
+  }
+  
+  /*
+  * Returns the integer part of a float
+  * Remark: r = x rounded towards zero.
+  */
+  void mbiFloatGetNum( bigintnum* r, const bigintfloat* x )
+  {
+    if( x->expo >= 0 )
+      mbiNumShiftLeft( r, &x->mant, (unsigned long)x->expo * DIGIT_BITS );
+    else
+      mbiNumShiftRight( r, &x->mant, (unsigned long)( -x->expo ) * DIGIT_BITS, false );
+  }
+  
+  /*
+  * Multiplies a float by a power of two
+  * Remark: r = a * 2^e, which is exact unless the mantissa grows over the
+    precision of r by the shift. r may be the same float as a.
+  */
+  void mbiFloatMulPow2( bigintfloat* r, const bigintfloat* a, long e )
+  {
+    long q = e / (long)DIGIT_BITS;
+    long s = e % (long)DIGIT_BITS;
+    if( s < 0 ){
+      s += DIGIT_BITS;
+      q--;
+    }
+    mbiNumShiftLeft( &r->mant, &a->mant, (unsigned long)s );
+    r->expo = a->expo + q;
+    mbiFloatNormalize( r );
+  }
+  
+  /*
+  * Aligns the mantissa of a float to an exponent
+  * Remark: t = x * B^{-e} rounded towards zero.
+  */
+  void mbiFloatAlign( bigintnum* t, const bigintfloat* x, long e )
+  {
+    if( x->expo >= e )
+      mbiNumShiftLeft( t, &x->mant, (unsigned long)( x->expo - e ) * DIGIT_BITS );
+    else
+      mbiNumShiftRight( t, &x->mant, (unsigned long)( e - x->expo ) * DIGIT_BITS, false );
+  }
   
+  /*
+  * Adds or subtracts two floats
+  * Remark: r = a + b or r = a - b, depending on subtract, truncated to the
+    precision of r. The digits of the operands below the last digit of r
+    and one guard digit are not looked at. r may be the same float as a or
+    b.
+  */
+  void mbiFloatAddSub( bigintfloat* r, const bigintfloat* a, const bigintfloat* b, bool subtract )
+  {
+    
+    if( b->mant.length == 0 ){
+      mbiFloatSet( r, a );
+      return;
+    }
+    if( a->mant.length == 0 ){
+      mbiFloatSet( r, b );
+      if( subtract ) r->mant.negative = !r->mant.negative;
+      mbiNumNormalize( &r->mant );
+      return;
+    }
+    
+    long ta = a->expo + (long)a->mant.length;
+    long tb = b->expo + (long)b->mant.length;
+    long low = ( ta > tb ? ta : tb ) - (long)r->prec - 1;
+    long e = a->expo < b->expo ? a->expo : b->expo;
+    if( e < low ) e = low;
+    
+    bigintnum x, y;
+    mbiNumInit( &x, r->mant.allocator );
+    mbiNumInit( &y, r->mant.allocator );
+    mbiFloatAlign( &x, a, e );
+    mbiFloatAlign( &y, b, e );
+    
+    mbiNumAddSub( &r->mant, &x, &y, subtract );
+    r->expo = e;
+    mbiFloatNormalize( r );
+    
+    mbiNumFree( &x );
+    mbiNumFree( &y );
+  }
   
+  /*
+  * Adds two floats
+  * Remark: r = a + b, see FloatAddSub.
+  */
+  void mbiFloatAdd( bigintfloat* r, const bigintfloat* a, const bigintfloat* b )
+  {
+    mbiFloatAddSub( r, a, b, false );
+  }
   
+  /*
+  * Subtracts two floats
+  * Remark: r = a - b, see FloatAddSub.
+  */
+  void mbiFloatSub( bigintfloat* r, const bigintfloat* a, const bigintfloat* b )
+  {
+    mbiFloatAddSub( r, a, b, true );
+  }
   
+  /*
+  * Multiplies two floats
+  * Remark: r = a * b truncated to the precision of r, which may be the
+    same float as a or b. The operands are cut to their upper n = prec+1
+    digits. If both have more than 3n/4 digits then, they are padded to n
+    digits and only the upper half of their product is computed by MulHi,
+    else the product of the cut operands is computed in full, which is
+    cheaper for short operands.
+  */
+  void mbiFloatMul( bigintfloat* r, const bigintfloat* a, const bigintfloat* b )
+  {
+    
+    bigintlength la = a->mant.length, lb = b->mant.length;
+    if( la == 0 || lb == 0 ){
+      r->mant.length   = 0;
+      r->mant.negative = false;
+      r->expo = 0;
+      return;
+    }
+    
+    bigintlength n  = r->prec + 1;
+    bigintlength ta = la < n ? la : n;
+    bigintlength tb = lb < n ? lb : n;
+    const bigint* da = a->mant.digits + ( la - ta );
+    const bigint* db = b->mant.digits + ( lb - tb );
+    long expo = a->expo + (long)( la - ta ) + b->expo + (long)( lb - tb );
+    
+    bigintnum p;
+    mbiNumInit( &p, r->mant.allocator );
+    
+    if( 4*ta > 3*n && 4*tb > 3*n ){
+      
+      /* operands shorter than n are padded with zero digits below */
+      bigintlength pa = n - ta, pb = n - tb;
+      mbiNumReserve( &p, 3*n );
+      bigint *xa = p.digits + n, *xb = p.digits + 2*n;
+      if( pa > 0 || pb > 0 ){
+        mbiSetZero( pa, xa );
+        mbiCopy( ta, xa + pa, da );
+        mbiSetZero( pb, xb );
+        mbiCopy( tb, xb + pb, db );
+        da = xa;
+        db = xb;
+      }
+      
+      mbiMulHi( n, p.digits, da, db );
+      p.length = n;
+      expo += (long)n - (long)( pa + pb );
+    }else{
+      mbiNumReserve( &p, ta + tb );
+      if( a == b )
+        mbiSquareN( ta, p.digits, da );
+      else
+        mbiMultiplyUnbalanced( p.digits, ta, da, tb, db );
+      p.length = ta + tb;
+    }
+    
+    p.negative = a->mant.negative != b->mant.negative;
+    mbiNumSwap( &r->mant, &p );
+    mbiNumFree( &p );
+    r->expo = expo;
+    mbiFloatNormalize( r );
+  }
   
+  /*
+  * Returns the precisions of a Newton iteration
+  * Remark: prec[0] is the final precision, each following one is about
+    half the one before, down to at most 4 digits. A step from one
+    precision to the next higher one then has two digits to spare, for
+    the truncation errors. Returns the number of precisions.
+  */
+  int mbiFloatNewtonPrecisions( bigintlength target, bigintlength* prec )
+  {
+    int steps = 0;
+    prec[steps++] = target;
+    while( target > 4 ){
+      target = target/2 + 2;
+      prec[steps++] = target;
+    }
+    return steps;
+  }
   
+  /*
+  * Computes the inverse of a float
+  * Remark: r = 1 / a at the precision of r, which may be the same float
+    as a. a must not be zero. The first approximation of about two digits
+    is the quotient of integers from the upper three digits of a. The
+    Newton step x = x + x (1 - a x) doubles the number of correct digits,
+    at a precision which is raised from 4 digits up to prec+1.
+  */
+  void mbiFloatInv( bigintfloat* r, const bigintfloat* a )
+  {
+    
+    assert( a->mant.length > 0 );
+    
+    const bigintallocator* allocator = r->mant.allocator;
+    bigintlength la = a->mant.length;
+    bigintlength tl = la < 3 ? la : 3;
+    bool negative = a->mant.negative;
+    
+    /* the absolute value shares the digits of a */
+    bigintfloat aa = *a;
+    aa.mant.negative = false;
+    
+    bigintlength prec[ 8 * sizeof(bigintlength) ];
+    int steps = mbiFloatNewtonPrecisions( r->prec + 1, prec );
+    
+    bigintfloat x, t, u, one;
+    mbiFloatInit( &x, prec[steps-1], allocator );
+    mbiFloatInit( &t, 1, allocator );
+    mbiFloatInit( &u, 1, allocator );
+    mbiFloatInit( &one, 1, allocator );
+    mbiFloatSetDigit( &one, 1, false );
+    
+    /* a = T B^E for the upper digits T, 1/a is about B^{2 tl} / T B^{-2 tl - E} */
+    {
+      bigintnum T, N;
+      mbiNumInit( &T, allocator );
+      mbiNumInit( &N, allocator );
+      mbiNumSet( &T, tl, a->mant.digits + la - tl, false );
+      bigint d = 1;
+      mbiNumSet( &N, 1, &d, false );
+      mbiNumShiftLeft( &N, &N, 2 * tl * DIGIT_BITS );
+      mbiNumDivRem( &x.mant, NULL, &N, &T );
+      x.expo = -2 * (long)tl - ( a->expo + (long)( la - tl ) );
+      mbiFloatNormalize( &x );
+      mbiNumFree( &T );
+      mbiNumFree( &N );
+    }
+    
+    for( int i = steps - 1; i >= 0; i-- )
+    {
+      bigintlength p = prec[i];
+      bigintlength h = i + 1 < steps ? prec[i+1] : p / 2;
+      
+      mbiFloatSetPrecision( &t, p );
+      mbiFloatMul( &t, &aa, &x );
+      mbiFloatSub( &t, &one, &t );
+      
+      /* 1 - a x has about h leading zero digits */
+      mbiFloatSetPrecision( &u, p - h + 2 );
+      mbiFloatMul( &u, &x, &t );
+      
+      mbiFloatSetPrecision( &x, p );
+      mbiFloatAdd( &x, &x, &u );
+    }
+    
+    x.mant.negative = negative && x.mant.length > 0;
+    mbiFloatSet( r, &x );
+    
+    mbiFloatFree( &x );
+    mbiFloatFree( &t );
+    mbiFloatFree( &u );
+    mbiFloatFree( &one );
+  }
   
+  /*
+  * Divides two floats
+  * Remark: r = a / b at the precision of r, as a times the inverse of b.
+    r may be the same float as a or b. b must not be zero.
+  */
+  void mbiFloatDiv( bigintfloat* r, const bigintfloat* a, const bigintfloat* b )
+  {
+    bigintfloat x;
+    mbiFloatInit( &x, r->prec + 1, r->mant.allocator );
+    mbiFloatInv( &x, b );
+    mbiFloatMul( r, a, &x );
+    mbiFloatFree( &x );
+  }
   
+  /*
+  * Computes the square root of a float
+  * Remark: r = sqrt(a) at the precision of r, which may be the same float
+    as a. a must not be negative. The inverse square root y is found by
+    the Newton step y = y + y (1 - a y^2) / 2, starting from integer roots
+    of the upper digits of a, and the root is a y.
+  */
+  void mbiFloatSqrt( bigintfloat* r, const bigintfloat* a )
+  {
+    
+    assert( !a->mant.negative );
+    if( a->mant.length == 0 ){
+      mbiFloatSet( r, a );
+      return;
+    }
+    
+    const bigintallocator* allocator = r->mant.allocator;
+    bigintlength la = a->mant.length;
+    
+    bigintlength prec[ 8 * sizeof(bigintlength) ];
+    int steps = mbiFloatNewtonPrecisions( r->prec + 1, prec );
+    
+    bigintfloat y, t, u, one;
+    mbiFloatInit( &y, prec[steps-1], allocator );
+    mbiFloatInit( &t, 1, allocator );
+    mbiFloatInit( &u, 1, allocator );
+    mbiFloatInit( &one, 1, allocator );
+    mbiFloatSetDigit( &one, 1, false );
+    
+    /*
+    * a = T B^E for the upper tl digits T, with E even. With S the integer
+    * root of T B^{2 tl}, 1/sqrt(a) is about B^{3 tl} / S B^{-2 tl - E/2}.
+    */
+    {
+      bigintlength tl = la < 3 ? la : 3;
+      long E = a->expo + (long)( la - tl );
+      if( E % 2 != 0 && tl < la ){
+        tl++;
+        E--;
+      }
+      
+      bigintnum T, S, N;
+      mbiNumInit( &T, allocator );
+      mbiNumInit( &S, allocator );
+      mbiNumInit( &N, allocator );
+      mbiNumSet( &T, tl, a->mant.digits + la - tl, false );
+      if( E % 2 != 0 ){
+        mbiNumShiftLeft( &T, &T, DIGIT_BITS );
+        tl++;
+        E--;
+      }
+      
+      mbiNumShiftLeft( &N, &T, 2 * tl * DIGIT_BITS );
+      mbiNumRootRem( &S, NULL, &N, 2 );
+      bigint d = 1;
+      mbiNumSet( &N, 1, &d, false );
+      mbiNumShiftLeft( &N, &N, 3 * tl * DIGIT_BITS );
+      mbiNumDivRem( &y.mant, NULL, &N, &S );
+      y.expo = -2 * (long)tl - E / 2;
+      mbiFloatNormalize( &y );
+      
+      mbiNumFree( &T );
+      mbiNumFree( &S );
+      mbiNumFree( &N );
+    }
+    
+    for( int i = steps - 1; i >= 0; i-- )
+    {
+      bigintlength p = prec[i];
+      bigintlength h = i + 1 < steps ? prec[i+1] : p / 2;
+      
+      mbiFloatSetPrecision( &t, p );
+      mbiFloatMul( &t, &y, &y );
+      mbiFloatMul( &t, a, &t );
+      mbiFloatSub( &t, &one, &t );
+      
+      mbiFloatSetPrecision( &u, p - h + 2 );
+      mbiFloatMul( &u, &y, &t );
+      mbiFloatMulPow2( &u, &u, -1 );
+      
+      mbiFloatSetPrecision( &y, p );
+      mbiFloatAdd( &y, &y, &u );
+    }
+    
+    mbiFloatMul( r, a, &y );
+    
+    mbiFloatFree( &y );
+    mbiFloatFree( &t );
+    mbiFloatFree( &u );
+    mbiFloatFree( &one );
+  }
   
   
   
   
+  /*********************************************/
+  /* Residue number systems                    */
+  /*********************************************/
   
+  /*
+  * A residue number system keeps a number by its residues modulo count
+  * primes p_i < 2^62, the lanes. Products, sums and differences are done
+  * lane by lane without any carries between the lanes, so a long chain of
+  * operations falls apart into independent parts, see mbiRnsParallel in
+  * async.h. Numbers are converted into residues by a remainder tree and
+  * back by the Chinese remainder theorem along the product tree of the
+  * primes, once at the ends of a chain. All values of the chain must stay
+  * below the bound of the system, else the results are only right modulo
+  * the product M of the primes.
+  *
+  * Residues are kept in Montgomery form, x R mod p for R = 2^64, so a
+  * product of two residues is one Montgomery reduction. A vector of
+  * residues is an array of count digits.
+  */
   
+  /* Nodes of the product tree of up to this many digits divide by the school method */
+  #ifndef MBI_RNS_NEWTON
+  #define MBI_RNS_NEWTON 64
+  #endif
   
+  /* Remainders of up to this many digits, or for up to this many primes, are reduced by each prime directly */
+  #ifndef MBI_RNS_LEAF
+  #define MBI_RNS_LEAF 64
+  #endif
   
+  typedef struct {
+    unsigned int count;
+    bigint* primes;
+    bigint* pinv;           /* -1/p_i mod R */
+    bigint* r2;             /* R^2 mod p_i */
+    bigint* crt;            /* 1/(M/p_i) mod p_i */
+    unsigned int nodes;
+    bigintnum* products;    /* product tree, node v has the children 2v and 2v+1 */
+    bigintfloat* inverses;  /* inverses of the nodes with more than MBI_RNS_NEWTON digits */
+  } bigintrns;
   
   
+  /*
+  * Montgomery product of two residues
+  * Remark: Returns a b / R mod p for a, b < p < 2^62 and pinv = -1/p mod R.
+  */
+  bigint mbiRnsMulMod( bigint a, bigint b, bigint p, bigint pinv )
+  {
+    bigint hi, lo = mbiMulDigits( a, b, &hi );
+    bigint mhi;
+    mbiMulDigits( lo * pinv, p, &mhi );
+    /* the lower digit of the sum vanishes and carries if lo is not zero */
+    bigint r = hi + mhi + ( lo != 0 );
+    return r >= p ? r - p : r;
+  }
   
+  /*
+  * Reduces a digit modulo a prime
+  * Remark: For p close to 2^62, d = d_1 2^62 + d_0 is d_0 + d_1 (2^62 - p)
+    modulo p, which is below 2p without any division or branches.
+  */
+  bigint mbiRnsDigitMod( bigint d, bigint p )
+  {
+    bigint e = ( d & ( ((bigint)1 << 62) - 1 ) ) + ( d >> 62 ) * ( ((bigint)1 << 62) - p );
+    return e >= p ? e - p : e;
+  }
   
-  /*******************************************************/
-  /* Karatsuba-Ofmann-Algorithm                          */
-  /*******************************************************/
+  /*
+  * Power of a residue
+  * Remark: a and the result are in Montgomery form, one is R mod p.
+  */
+  bigint mbiRnsPowMod( bigint a, bigint e, bigint p, bigint pinv, bigint one )
+  {
+    bigint r = one;
+    for( ; e > 0; e >>= 1 )
+    {
+      if( e & 1 ) r = mbiRnsMulMod( r, a, p, pinv );
+      a = mbiRnsMulMod( a, a, p, pinv );
+    }
+    return r;
+  }
   
+  /*
+  * Returns -1/p mod R for odd p
+  * Remark: Newton's iteration doubles the correct bits, starting with the
+    three bits of p itself.
+  */
+  bigint mbiRnsInverse( bigint p )
+  {
+    assert( p % 2 == 1 );
+    bigint x = p;
+    for( int i = 0; i < 5; i++ ) x *= 2 - p * x;
+    return -x;
+  }
   
   /*
-  * Multiplies to Big ints according to Karatsuba-Ofmann
-  * Bemerkung: Bigints a and b must have the same length, which must be of
-    form 2^{k}. p points to a Bigint of double size - 2^{k+1} - the result
-    is saved in.
+  * Primality test of a digit below 2^62
+  * Remark: Miller-Rabin with the seven bases of J. Sinclair, which has no
+    false positives below 2^64.
   */
-  void mbiMultiply( bigintexpo k, bigint* p, const bigint* a, const bigint* b )
+  bool mbiRnsIsPrime( bigint p )
   {
     
-    /* calculate length of a and b */
-    bigintlength length = 1 << k;
+    static const bigint bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+    static const bigint small[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47 };
     
-    /*
-    * if we are below the threshold, switch to school method
-    * Die Wechselgrenze wurde empirisch ueber den Daumen geschaetzt
-    */  
-    if( k <= 5 ){
-      mbiNaivMultiplication( k, p, a, b );
-      return;
-    }
+    assert( p < ((bigint)1 << 62) );
+    if( p < 2 ) return false;
+    for( unsigned int i = 0; i < sizeof(small)/sizeof(small[0]); i++ )
+      if( p % small[i] == 0 ) return p == small[i];
     
-    /***************************************/
-    /* Declaration and initialization      */
-    /***************************************/
+    bigint pinv = mbiRnsInverse( p ), one, r2;
+    mbiDivDigits( 1, 0, p, &one );
+    mbiDivDigits( one, 0, p, &r2 );
+    bigint minus = p - one;
     
-    /* pointers to the low- and high-parts of the factors */
-    const bigint *al,*ah,*bl,*bh;
-    al = a;
-    bl = b;
-    ah = a + length/2;
-    bh = b + length/2;
+    bigint d = p - 1;
+    int s = 0;
+    while( d % 2 == 0 ){ d /= 2; s++; }
     
-    /* Pointers to target memory */
-    bigint *u1, *u2, *u3, *u4;
-    u1 = p;
-    u2 = p + length/2;
-    u3 = p + length;
-    u4 = p + length + length/2;
+    for( unsigned int i = 0; i < sizeof(bases)/sizeof(bases[0]); i++ )
+    {
+      bigint a = bases[i] % p;
+      if( a == 0 ) continue;
+      bigint x = mbiRnsPowMod( mbiRnsMulMod( a, r2, p, pinv ), d, p, pinv, one );
+      if( x == one || x == minus ) continue;
+      int j;
+      for( j = 1; j < s; j++ )
+      {
+        x = mbiRnsMulMod( x, x, p, pinv );
+        if( x == minus ) break;
+      }
+      if( j == s ) return false;
+    }
     
-    /* Pointer to heap */
-    //bigint *heap = malloc( length * sizeof(bigint) );
-    bigint heap[length];
+    return true;
+  }
+  
+  /*
+  * Reduces a number modulo a node of the product tree
+  * Remark: r = a mod P_v for a >= 0, r may be a. If P_v is large and a has
+    at most one digit more than twice its digits, a is multiplied by the
+    inverse of P_v and the quotient is corrected by a few steps, else the
+    school method divides.
+  */
+  void mbiRnsReduce( const bigintrns* b, bigintnum* r, const bigintnum* a, unsigned int v )
+  {
     
-    assert( heap != NULL );
-    bigint *aux1, *aux2;
-    aux1 = heap;
-    aux2 = heap + length/2;
+    const bigintnum* P = &b->products[v];
+    assert( !a->negative );
     
-    /* Pointer to products ahbh and albl */
-    bigint *ahbh = u3;
-    bigint *albl = u1;
+    if( mbiNumCompareAbs( a, P ) < 0 ){
+      if( r != a ) mbiNumSet( r, a->length, a->digits, false );
+      return;
+    }
     
-    /* Memory for some of the carries
-    due to performance issues */
-    bigint overflow = (bigint)0;
+    if( P->length <= MBI_RNS_NEWTON || a->length > 2*P->length + 1 ){
+      mbiNumDivRem( NULL, r, a, P );
+      return;
+    }
     
+    bigintnum q, t;
+    bigintfloat f;
+    mbiNumInit( &q, NULL );
+    mbiNumInit( &t, NULL );
+    mbiFloatInit( &f, a->length, NULL );
     
-    /******************************/
-    /* Calculations               */
-    /******************************/
+    mbiFloatSetNum( &f, a );
+    mbiFloatMul( &f, &f, &b->inverses[v] );
+    mbiFloatGetNum( &q, &f );
     
-    /* Calculate middle product */
+    mbiNumMul( &t, &q, P );
+    mbiNumSub( r, a, &t );
+    while( r->negative ) mbiNumAdd( r, r, P );
+    while( mbiNumCompare( r, P ) >= 0 ) mbiNumSub( r, r, P );
     
-    /* Calculate (al + ah)(bl + bh) */
+    mbiNumFree( &q );
+    mbiNumFree( &t );
+    mbiFloatFree( &f );
+  }
+  
+  /*
+  * Builds the product tree of the primes lo <= i < hi at node v
+  * Remark: The inverses of the large nodes are found as well.
+  */
+  void mbiRnsBuild( bigintrns* b, unsigned int v, unsigned int lo, unsigned int hi )
+  {
     
-    /* Calculate the two sums */  
-    bool carrya = false;
-    bool carryb = false;
-    mbiCopyAdd( length/2, u4, al, ah, &carrya );
-    mbiCopyAdd( length/2, u1, bl, bh, &carryb );
+    bigintnum* P = &b->products[v];
     
-    /* Multiply both */
-      
-    /* First recursion */  
-    mbiMultiply( k-1, aux1, u1, u4 );
+    if( hi - lo == 1 ){
+      mbiNumSet( P, 1, &b->primes[lo], false );
+      return;
+    }
     
-    /* Do some additions, to calculate the high-part of the product */ 
+    unsigned int mid = ( lo + hi ) / 2;
+    mbiRnsBuild( b, 2*v, lo, mid );
+    mbiRnsBuild( b, 2*v+1, mid, hi );
+    mbiNumMul( P, &b->products[2*v], &b->products[2*v+1] );
     
-    bool carryt = false;
-      
-    carryt = false;
-    if( carryb ) mbiAdd( length/2, aux2, u4, &carryt );
-    if( carryt ) overflow++;
+    if( P->length > MBI_RNS_NEWTON ){
+      bigintfloat* f = &b->inverses[v];
+      mbiFloatSetPrecision( f, P->length + 3 );
+      mbiFloatSetNum( f, P );
+      mbiFloatInv( f, f );
+    }
+  }
   
-    carryt = false;
-    if( carrya ) mbiAdd( length/2, aux2, u1, &carryt );
-    if( carryt ) overflow++;
-    
-    if( carrya && carryb ) overflow++;
-    
-    /*
-    * Now the heap is (al+ah)(bl+bh)
-    * We write al*bl and ah*bh directly into the target memory
-    */  
+  /*
+  * Finds the coefficients of the Chinese remainder theorem below node v
+  * Remark: c is (M/P_v) mod P_v. Going down, (M/P_2v) mod P_2v is
+    (c mod P_2v) P_2v+1 mod P_2v and vice versa, and at the leaves it is
+    inverted. Reducing c first keeps the divisions at twice the length.
+  */
+  void mbiRnsCofactors( bigintrns* b, unsigned int v, unsigned int lo, unsigned int hi, const bigintnum* c )
+  {
     
-    /* Calculate albl */
-    mbiMultiply( k-1, albl, al, bl );
+    if( hi - lo == 1 ){
+      bigint p = b->primes[lo], pinv = b->pinv[lo];
+      bigint one = mbiRnsMulMod( 1, b->r2[lo], p, pinv );
+      bigint x = mbiRnsMulMod( c->length > 0 ? c->digits[0] : 0, b->r2[lo], p, pinv );
+      /* Fermat's little theorem, the primes are distinct so x is not zero */
+      x = mbiRnsPowMod( x, p - 2, p, pinv, one );
+      b->crt[lo] = mbiRnsMulMod( x, 1, p, pinv );
+      return;
+    }
     
-    /* Calculate ahbh */
-    mbiMultiply( k-1, ahbh, ah, bh );
+    unsigned int mid = ( lo + hi ) / 2;
+    bigintnum t;
+    mbiNumInit( &t, NULL );
     
-    /* Sub the two products from the heap */
+    mbiRnsReduce( b, &t, c, 2*v );
+    mbiNumMul( &t, &t, &b->products[2*v+1] );
+    mbiRnsReduce( b, &t, &t, 2*v );
+    mbiRnsCofactors( b, 2*v, lo, mid, &t );
     
-    bool carrys = false;
-     
-    carrys = false;
-    mbiSub( length, heap, albl, &carrys );
-    if( carrys ) overflow--;
+    mbiRnsReduce( b, &t, c, 2*v+1 );
+    mbiNumMul( &t, &t, &b->products[2*v] );
+    mbiRnsReduce( b, &t, &t, 2*v+1 );
+    mbiRnsCofactors( b, 2*v+1, mid, hi, &t );
     
-    carrys = false;
-    mbiSub( length, heap, ahbh, &carrys );
-    if( carrys ) overflow--;
+    mbiNumFree( &t );
+  }
+  
+  /*
+  * Initializes a residue number system for numbers of up to bits bits
+  * Remark: Takes the largest primes below 2^62, enough of them that M is
+    above 2^(bits+1), so numbers of both signs below 2^bits are kept
+    exactly. The product tree of the primes and the coefficients for the
+    way back are computed here, once for all conversions.
+  */
+  void mbiRnsInit( bigintrns* b, unsigned long bits )
+  {
     
-    /*
-    * Add the term at the heap to right place in the target
-    * Evaluate the overflows
-    */
+    assert( DIGIT_BITS == 64 );
     
-    bool carryq = false;
+    /* every prime has more than 61 bits */
+    unsigned int count = (unsigned int)( ( bits + 1 ) / 61 + 1 );
     
-    mbiAdd( length, u2, heap, &carryq );
-    if( carryq ) overflow++;
+    b->count = count;
+    b->primes = mbiAlloc( sizeof(bigint) * 4*count );
+    assert( b->primes != NULL );
+    b->pinv = b->primes + count;
+    b->r2   = b->pinv + count;
+    b->crt  = b->r2 + count;
     
-    if( overflow == 1 ){
-      carryq = false;
-      mbiInc( length/2, u4, &carryq );
-    }else if( overflow == 2 ){
-      carryq = false;
-      mbiInc( length/2, u4, &carryq );
-      carryq = false;
-      mbiInc( length/2, u4, &carryq );
+    bigint p = ((bigint)1 << 62) - 1;
+    for( unsigned int i = 0; i < count; i++, p -= 2 )
+    {
+      while( !mbiRnsIsPrime( p ) ) p -= 2;
+      bigint one;
+      b->primes[i] = p;
+      b->pinv[i] = mbiRnsInverse( p );
+      mbiDivDigits( 1, 0, p, &one );
+      mbiDivDigits( one, 0, p, &b->r2[i] );
     }
-        
-    /**********************************/
-    /* Result is in the target memory */
-    /**********************************/
     
-    /* free all memory */
-    //free( heap );   
+    /* heap numbering of a tree of depth ceil(log2 count) */
+    b->nodes = 4*count;
+    b->products = mbiAlloc( sizeof(bigintnum) * b->nodes );
+    b->inverses = mbiAlloc( sizeof(bigintfloat) * b->nodes );
+    assert( b->products != NULL && b->inverses != NULL );
+    for( unsigned int v = 0; v < b->nodes; v++ )
+    {
+      mbiNumInit( &b->products[v], NULL );
+      mbiFloatInit( &b->inverses[v], 1, NULL );
+    }
     
+    mbiRnsBuild( b, 1, 0, count );
     
-    /*{
-      bigint* test = malloc( length*2 * sizeof(bigint) );
-      NaivMultiplication( k, test, a, b );
-      if( Compare( length*2, test, p ) ){
-        printf( "Hauptrechnung: %d\n", length );
-        OutputBigint( length, a );
-        OutputBigint( length, b );
-        OutputBigint( length*2, p );
-        OutputBigint( length*2, test );
-        assert(false);
-      }
-      free(test);
-    }*/
-
+    bigintnum c;
+    bigint d = 1;
+    mbiNumInit( &c, NULL );
+    mbiNumSet( &c, 1, &d, false );
+    mbiRnsCofactors( b, 1, 0, count, &c );
+    mbiNumFree( &c );
   }
-    
-    
-    
-  
   
+  /*
+  * Frees the memory of a residue number system
+  * Remark: None
+  */
+  void mbiRnsFree( bigintrns* b )
+  {
+    for( unsigned int v = 0; v < b->nodes; v++ )
+    {
+      mbiNumFree( &b->products[v] );
+      mbiFloatFree( &b->inverses[v] );
+    }
+    mbiFree( b->products, sizeof(bigintnum) * b->nodes );
+    mbiFree( b->inverses, sizeof(bigintfloat) * b->nodes );
+    mbiFree( b->primes, sizeof(bigint) * 4*b->count );
+    b->count = 0;
+    b->nodes = 0;
+  }
   
-      
-      
-  
+  /*
+  * Multiplies residues lane by lane
+  * Remark: dest, x and y point to n residues modulo p with pinv as in
+    the system, dest may be x or y. Pointers to the lanes lo <= i < lo+n of
+    a system give a part of a vector.
+  */
+  void mbiRnsMulLanes( unsigned int n, bigint* dest, const bigint* x, const bigint* y, const bigint* p, const bigint* pinv )
+  {
+    for( unsigned int i = 0; i < n; i++ )
+      dest[i] = mbiRnsMulMod( x[i], y[i], p[i], pinv[i] );
+  }
   
+  /*
+  * Adds residues lane by lane
+  * Remark: Like MulLanes.
+  */
+  void mbiRnsAddLanes( unsigned int n, bigint* dest, const bigint* x, const bigint* y, const bigint* p )
+  {
+    for( unsigned int i = 0; i < n; i++ )
+    {
+      bigint s = x[i] + y[i];
+      dest[i] = s >= p[i] ? s - p[i] : s;
+    }
+  }
   
+  /*
+  * Subtracts residues lane by lane
+  * Remark: Like MulLanes.
+  */
+  void mbiRnsSubLanes( unsigned int n, bigint* dest, const bigint* x, const bigint* y, const bigint* p )
+  {
+    for( unsigned int i = 0; i < n; i++ )
+    {
+      bigint s = x[i] - y[i];
+      dest[i] = x[i] < y[i] ? s + p[i] : s;
+    }
+  }
   
+  /*
+  * Multiplies two vectors of residues
+  * Remark: dest may be x or y.
+  */
+  void mbiRnsMul( const bigintrns* b, bigint* dest, const bigint* x, const bigint* y )
+  {
+    mbiRnsMulLanes( b->count, dest, x, y, b->primes, b->pinv );
+  }
   
+  /*
+  * Adds two vectors of residues
+  * Remark: dest may be x or y.
+  */
+  void mbiRnsAdd( const bigintrns* b, bigint* dest, const bigint* x, const bigint* y )
+  {
+    mbiRnsAddLanes( b->count, dest, x, y, b->primes );
+  }
   
-  /*********************************************/
-  /* Non-essential operations                  */
-  /* for an easier handling                    */
-  /*********************************************/
-    
   /*
-  * Returns an exponent k, s.t. n <= 2^{k}
-  * Bemerkung: Absolutely no optimization
+  * Subtracts two vectors of residues
+  * Remark: dest may be x or y.
   */
-  bigintexpo getFittingExponent( bigintlength n )
+  void mbiRnsSub( const bigintrns* b, bigint* dest, const bigint* x, const bigint* y )
   {
-    bigintexpo k = 0;
-    while ( (bigintlength)(1L<<k) < n && k <= (bigintexpo)254 ) k++;
-    return k;
+    mbiRnsSubLanes( b->count, dest, x, y, b->primes );
   }
   
+  /*
+  * Residues of a single digit
+  * Remark: dest receives the residues of d, or of -d if negative is true.
+  */
+  void mbiRnsSetDigit( const bigintrns* b, bigint* dest, bigint d, bool negative )
+  {
+    for( unsigned int i = 0; i < b->count; i++ )
+    {
+      bigint p = b->primes[i];
+      bigint r = mbiRnsMulMod( mbiRnsDigitMod( d, p ), b->r2[i], p, b->pinv[i] );
+      dest[i] = negative && r != 0 ? p - r : r;
+    }
+  }
   
+  /*
+  * Finds the residues of t < P_v for the primes lo <= i < hi
+  * Remark: Short numbers are reduced by each prime directly, and t is
+    passed down as it is while it is below the child.
+  */
+  void mbiRnsRemainders( const bigintrns* b, bigint* dest, const bigintnum* t, unsigned int v, unsigned int lo, unsigned int hi )
+  {
+    
+    if( hi - lo <= MBI_RNS_LEAF || t->length <= MBI_RNS_LEAF ){
+      /* r B + d by Horner's rule, where r B is the Montgomery product of
+         r and R^2; the primes are the inner loop, so the chains overlap */
+      for( unsigned int i = lo; i < hi; i++ ) dest[i] = 0;
+      for( bigintlength j = t->length; j > 0; j-- )
+        for( unsigned int i = lo; i < hi; i++ )
+        {
+          bigint p = b->primes[i];
+          bigint r = mbiRnsMulMod( dest[i], b->r2[i], p, b->pinv[i] ) + mbiRnsDigitMod( t->digits[j-1], p );
+          dest[i] = r >= p ? r - p : r;
+        }
+      for( unsigned int i = lo; i < hi; i++ )
+        dest[i] = mbiRnsMulMod( dest[i], b->r2[i], b->primes[i], b->pinv[i] );
+      return;
+    }
+    
+    unsigned int mid = ( lo + hi ) / 2;
+    bigintnum u;
+    mbiNumInit( &u, NULL );
+    
+    for( unsigned int c = 0; c < 2; c++ )
+    {
+      unsigned int w = 2*v + c;
+      const bigintnum* r = t;
+      if( mbiNumCompareAbs( t, &b->products[w] ) >= 0 ){
+        mbiRnsReduce( b, &u, t, w );
+        r = &u;
+      }
+      mbiRnsRemainders( b, dest, r, w, c == 0 ? lo : mid, c == 0 ? mid : hi );
+    }
     
+    mbiNumFree( &u );
+  }
+  
   /*
-  * Multiplies numbers of arbitrary length
-  * Remark: It wraps the karatsuba-multiplication, s.t. we can multiply numbers
-  * whose length is not a power of 2. Absolutely no optimization for this
+  * Converts a handle into residues
+  * Remark: dest receives the count residues of x, which may be negative.
+    The remainder tree reduces x modulo the nodes of the product tree from
+    the top down.
   */
-  void mbiMultiplikation( bigint* dest, bigintlength n1, const bigint* fak1, bigintlength n2, const bigint* fak2 )
+  void mbiRnsFromNum( const bigintrns* b, bigint* dest, const bigintnum* x )
   {
     
-    assert( dest != NULL );
-    assert( fak1 != NULL );
-    assert( fak2 != NULL );
+    bigintnum t;
+    mbiNumInit( &t, NULL );
+    mbiNumSet( &t, x->length, x->digits, false );
+    mbiRnsReduce( b, &t, &t, 1 );
+    mbiRnsRemainders( b, dest, &t, 1, 0, b->count );
+    mbiNumFree( &t );
     
-    bigintlength nmax = n1 > n2 ? n1 : n2;
-    bigintexpo k = getFittingExponent( nmax );
+    if( x->negative )
+      for( unsigned int i = 0; i < b->count; i++ )
+        if( dest[i] != 0 ) dest[i] = b->primes[i] - dest[i];
+  }
+  
+  /*
+  * Sums y_i M_v/p_i for the primes lo <= i < hi of node v
+  * Remark: y_i = x_i / (M/p_i) mod p_i. The sum of node v is the sum of
+    its first child times P_2v+1 plus the sum of the second times P_2v.
+  */
+  void mbiRnsCombine( const bigintrns* b, bigintnum* s, const bigint* x, unsigned int v, unsigned int lo, unsigned int hi )
+  {
     
-    if( (1L<<k) == 0 ){
-      printf( "Error: Summands are to long\n" );
+    if( hi - lo == 1 ){
+      /* x is in Montgomery form and crt is not, so this is a plain residue */
+      bigint y = mbiRnsMulMod( x[lo], b->crt[lo], b->primes[lo], b->pinv[lo] );
+      mbiNumSet( s, 1, &y, false );
       return;
     }
     
-    bigint *tempfak1, *tempfak2;
-    bigint *tempdest;
+    unsigned int mid = ( lo + hi ) / 2;
+    bigintnum t;
+    mbiNumInit( &t, NULL );
     
-    tempdest = calloc( sizeof(bigint) , (1<<k) * 4 );
-    tempfak1 = tempdest + (1<<k)*2;
-    tempfak2 = tempdest + (1<<k)*3;
-//     tempfak1 = calloc( sizeof(bigint) , (1<<k) ); 
-//     tempfak2 = calloc( sizeof(bigint) , (1<<k) );
-//     tempdest = calloc( sizeof(bigint) , (1<<k)*2 );
+    mbiRnsCombine( b, s, x, 2*v, lo, mid );
+    mbiNumMul( s, s, &b->products[2*v+1] );
+    mbiRnsCombine( b, &t, x, 2*v+1, mid, hi );
+    mbiNumMul( &t, &t, &b->products[2*v] );
+    mbiNumAdd( s, s, &t );
     
-    assert( tempdest != NULL );
-    assert( tempfak1 != NULL );
-    assert( tempfak2 != NULL );
+    mbiNumFree( &t );
+  }
+  
+  /*
+  * Converts residues into a handle
+  * Remark: r receives the number 0 <= r < M with the residues x, or the
+    one with -M/2 < r <= M/2 if sign is true. The sum of the Chinese
+    remainder theorem is below count M, so the final reduction has a
+    quotient of a single digit.
+  */
+  void mbiRnsToNum( const bigintrns* b, bigintnum* r, const bigint* x, bool sign )
+  {
     
-    mbiCopy( n1, tempfak1, fak1 );
-    mbiCopy( n2, tempfak2, fak2 );
+    const bigintnum* M = &b->products[1];
+    bigintnum s, t;
+    mbiNumInit( &s, r->allocator );
+    mbiNumInit( &t, NULL );
     
-    mbiMultiply( k, tempdest, tempfak1, tempfak2 );
+    mbiRnsCombine( b, &s, x, 1, 0, b->count );
+    mbiNumDivRem( NULL, &s, &s, M );
     
-    mbiCopy( n1+n2, dest, tempdest );
+    if( sign ){
+      mbiNumSub( &t, M, &s );
+      if( mbiNumCompare( &t, &s ) < 0 ){
+        mbiNumSwap( &s, &t );
+        s.negative = true;
+      }
+    }
     
-    //free( tempfak1 );
-    //free( tempfak2 );
-    free( tempdest );
-  } 
-  
-  
-  
-  
+    mbiNumSwap( r, &s );
+    mbiNumFree( &s );
+    mbiNumFree( &t );
+  }
   
   
   
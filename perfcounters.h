@@ -0,0 +1,206 @@
+#ifndef C_BIGINT_MULT_PERFCOUNTERS
+#define C_BIGINT_MULT_PERFCOUNTERS
+
+/*****************************************************************************
+
+  Hardware performance counters
+
+  Opens counters of the processor by perf_event_open around a measured
+  piece of code: cycles, instructions, L1 data cache misses, last level
+  cache misses and branch misses. With them a change in the timings can
+  be told apart into more instructions, more misses, or more mispredicted
+  branches, e.g. in the carry logic of Add and Sub.
+
+  - Every counter is opened on its own, so a counter which the processor
+    or the virtual machine does not have leaves the others working.
+  - Without Linux, or where perf_event_open is not allowed, as in many
+    containers (see /proc/sys/kernel/perf_event_paranoid), no counter is
+    open and only the time is measured.
+  - Only the calling thread is counted, in user mode. When the kernel has
+    to share the hardware counters among more events, the counts are
+    scaled by the time they ran.
+
+****************************************************************************/
+
+
+  #include "header.h"
+
+  #if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #endif
+
+
+
+
+  /*********************************************/
+  /* Datatypes and constants                   */
+  /*********************************************/
+
+  enum {
+    MBI_COUNT_CYCLES,
+    MBI_COUNT_INSTRUCTIONS,
+    MBI_COUNT_L1D_MISSES,
+    MBI_COUNT_LLC_MISSES,
+    MBI_COUNT_BRANCH_MISSES,
+    MBI_COUNTERS
+  };
+
+  /*
+  * A set of counters and the time of the last measurement. fd is -1 for
+  * the counters which could not be opened.
+  */
+  typedef struct {
+    int fd[MBI_COUNTERS];
+    double value[MBI_COUNTERS];
+    struct timespec start;
+    double seconds;
+  } bigintcounters;
+
+
+
+
+  /*********************************************/
+  /* Counters                                  */
+  /*********************************************/
+
+  /*
+  * Initializes a set of counters with none of them open
+  * Remark: Such a set only measures the time.
+  */
+  void mbiCountersInit( bigintcounters* c )
+  {
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+    {
+      c->fd[i] = -1;
+      c->value[i] = 0;
+    }
+    c->seconds = 0;
+  }
+
+  /*
+  * Opens the counters
+  * Remark: Returns the number of counters which could be opened, which
+    may be zero. The time is measured anyway.
+  */
+  int mbiCountersOpen( bigintcounters* c )
+  {
+
+    int opened = 0;
+    mbiCountersInit( c );
+
+  #if defined(__linux__) && defined(SYS_perf_event_open)
+
+    static const struct { uint32_t type; uint64_t config; } events[MBI_COUNTERS] = {
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+      { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
+
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+    {
+      struct perf_event_attr attr;
+      memset( &attr, 0, sizeof(attr) );
+      attr.size           = sizeof(attr);
+      attr.type           = events[i].type;
+      attr.config         = events[i].config;
+      attr.disabled       = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      /* this thread on any processor */
+      long fd = syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+      if( fd >= 0 ){
+        c->fd[i] = (int)fd;
+        opened++;
+      }
+    }
+
+  #endif
+
+    return opened;
+  }
+
+  /*
+  * Closes the counters
+  * Remark: None
+  */
+  void mbiCountersClose( bigintcounters* c )
+  {
+  #if defined(__linux__)
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+      if( c->fd[i] >= 0 ) close( c->fd[i] );
+  #endif
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+      c->fd[i] = -1;
+  }
+
+  /*
+  * Returns whether a counter is open
+  * Remark: None
+  */
+  bool mbiCountersHas( const bigintcounters* c, int i )
+  {
+    return c->fd[i] >= 0;
+  }
+
+  /*
+  * Starts a measurement
+  * Remark: The counters are reset.
+  */
+  void mbiCountersStart( bigintcounters* c )
+  {
+  #if defined(__linux__)
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+      if( c->fd[i] >= 0 ){
+        ioctl( c->fd[i], PERF_EVENT_IOC_RESET, 0 );
+        ioctl( c->fd[i], PERF_EVENT_IOC_ENABLE, 0 );
+      }
+  #endif
+    clock_gettime( CLOCK_MONOTONIC, &c->start );
+  }
+
+  /*
+  * Stops a measurement
+  * Remark: Reads the counts into value and the time into seconds. A
+    counter which cannot be read is closed.
+  */
+  void mbiCountersStop( bigintcounters* c )
+  {
+
+    struct timespec end;
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+  #if defined(__linux__)
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+      if( c->fd[i] >= 0 ) ioctl( c->fd[i], PERF_EVENT_IOC_DISABLE, 0 );
+
+    for( int i = 0; i < MBI_COUNTERS; i++ )
+    {
+      if( c->fd[i] < 0 ) continue;
+
+      /* count, time enabled, time running */
+      uint64_t data[3];
+      if( read( c->fd[i], data, sizeof(data) ) != (ssize_t)sizeof(data) ){
+        close( c->fd[i] );
+        c->fd[i] = -1;
+        continue;
+      }
+
+      if( data[2] == 0 )
+        c->value[i] = 0;
+      else
+        c->value[i] = (double)data[0] * ( (double)data[1] / (double)data[2] );
+    }
+  #endif
+
+    c->seconds = ( end.tv_sec - c->start.tv_sec ) + 1e-9 * ( end.tv_nsec - c->start.tv_nsec );
+  }
+
+
+
+
+#endif
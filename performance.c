@@ -4,17 +4,35 @@
     Compile with: 
     gcc example.c -std=c99 -pedantic -W -Wall -Wformat -Wextra -o performance.out 
 
+    Usage: performance.out [counters]
+
+    With "counters", the table of the kernels also shows the hardware
+    performance counters, where perf_event_open is available.
+
 ****************************************************************************/  
 
   
 
 
 #include "header.h"    
+#include "perfcounters.h"
     
   
 
   
-  int main()
+  /*
+  * Prints a count per digit, or a dash if the counter is not open
+  */
+  void printPerDigit( const bigintcounters* c, int i, double digits )
+  {
+    if( mbiCountersHas( c, i ) )
+      printf( " %11.4f", c->value[i] / digits );
+    else
+      printf( " %11s", "-" );
+  }
+  
+  
+  int main( int argc, char** argv )
   {
 
       
@@ -37,6 +55,9 @@
       
       long int v = 0, vmax = 10;
       
+      bigintrandom rng;
+      mbiRandomSeed( &rng, (uint64_t)time( NULL ) );
+      
       /* printf( "Multiply %ld-times two numbers of length %ld\n", vmax, l ); */
       printf( "-- %ld multiplication of two numbers of %ld digits each in base 2^32\n", vmax, l );
       printf( "-- approx. %lld decimal digits\n", (long long) 9 * l );
@@ -54,10 +75,8 @@
         bigint P[l], Q[l];
         bigint R[2*l];
         
-        srand( time(NULL) * rand() + v*v*v*v );
-        
-        mbiShuffle( l, P, 0 );
-        mbiShuffle( l, Q, 0 );
+        mbiRandomFill( &rng, l, P );
+        mbiRandomFill( &rng, l, Q );
         
         mbiMultiply( k, R, P, Q );
         
@@ -71,6 +90,88 @@
     
     }
     
+    /***************/
+    /* Kernels     */
+    /***************/
+    
+    /*
+    * Every kernel and size is repeated for about 20 ms, counts are per
+    * call and digit of the operands
+    */
+    
+    {
+      
+      enum { ADD, SUB, BASECASE, KARATSUBA, KERNELS };
+      static const char* names[KERNELS] = { "Add", "Sub", "MulBasecase", "Multiply" };
+      static const bigintexpo mink[KERNELS] = { 4, 4, 3, 4 };
+      static const bigintexpo maxk[KERNELS] = { 20, 20, 9, 14 };
+      
+      bigintcounters counters;
+      mbiCountersInit( &counters );
+      bool wanted = argc > 1 && strcmp( argv[1], "counters" ) == 0;
+      int opened = wanted ? mbiCountersOpen( &counters ) : 0;
+      
+      printf( "\nKernels" );
+      if( wanted && opened == 0 ) printf( ", no performance counters available (no hardware counters in this machine, or see /proc/sys/kernel/perf_event_paranoid)" );
+      if( opened > 0 ) printf( ", %d of %d performance counters", opened, (int)MBI_COUNTERS );
+      printf( "\n-- %-12s %8s %12s %8s %11s %11s %11s\n", "kernel", "digits", "us/call", "IPC", "L1D/digit", "LLC/digit", "brmis/digit" );
+      
+      bigintrandom rng;
+      mbiRandomSeed( &rng, 1 );
+      const bigintlength most = (bigintlength)1 << 20;
+      bigint* A = malloc( sizeof(bigint) * most );
+      bigint* B = malloc( sizeof(bigint) * most );
+      bigint* C = malloc( sizeof(bigint) * 2 * most );
+      mbiRandomFill( &rng, most, A );
+      mbiRandomFill( &rng, most, B );
+      
+      for( int kernel = 0; kernel < KERNELS; kernel++ )
+      for( bigintexpo k = mink[kernel]; k <= maxk[kernel]; k += 2 )
+      {
+        
+        const bigintlength n = (bigintlength)1 << k;
+        long reps = 1;
+        
+        /* Add and Sub work in place on C, so that only the carry loop is timed */
+        mbiCopy( n, C, A );
+        
+        /* double the repetitions until they take 20 ms */
+        for( ;; )
+        {
+          mbiCountersStart( &counters );
+          for( long r = 0; r < reps; r++ )
+          {
+            bool carry = false;
+            switch( kernel ){
+              case ADD:       mbiAdd( n, C, B, &carry ); break;
+              case SUB:       mbiSub( n, C, B, &carry ); break;
+              case BASECASE:  mbiMulBasecase( C, n, A, n, B ); break;
+              case KARATSUBA: mbiMultiply( k, C, A, B ); break;
+            }
+          }
+          mbiCountersStop( &counters );
+          if( counters.seconds >= 0.02 ) break;
+          reps *= 2;
+        }
+        
+        double digits = (double)reps * n;
+        printf( "-- %-12s %8lu %12.3f", names[kernel], (unsigned long)n, 1e6 * counters.seconds / reps );
+        if( mbiCountersHas( &counters, MBI_COUNT_CYCLES ) && mbiCountersHas( &counters, MBI_COUNT_INSTRUCTIONS ) && counters.value[MBI_COUNT_CYCLES] > 0 )
+          printf( " %8.2f", counters.value[MBI_COUNT_INSTRUCTIONS] / counters.value[MBI_COUNT_CYCLES] );
+        else
+          printf( " %8s", "-" );
+        printPerDigit( &counters, MBI_COUNT_L1D_MISSES, digits );
+        printPerDigit( &counters, MBI_COUNT_LLC_MISSES, digits );
+        printPerDigit( &counters, MBI_COUNT_BRANCH_MISSES, digits );
+        printf( "\n" );
+        
+      }
+      
+      mbiCountersClose( &counters );
+      free( A ); free( B ); free( C );
+      
+    }
+    
     return 0;
     
 
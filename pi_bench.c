@@ -0,0 +1,329 @@
+
+/****************************************************************************
+
+    Compile with:
+    gcc pi_bench.c -std=c99 -pedantic -W -Wall -Wformat -Wextra -O2 -o pi_bench.out
+
+    Usage: pi_bench.out [digits]
+
+    Computes digits of pi by the Chudnovsky series with binary splitting,
+    as a workload of unbalanced products, deep product trees, a large
+    division and a radix conversion. Prints the time of each phase and
+    checks the digits against known hashes.
+
+****************************************************************************/
+
+
+
+
+#include "header.h"
+
+
+
+  /*
+  * FNV-1a hashes of the digit strings "31415..." of pi with 1 + digits
+  * characters, computed independently
+  */
+  static const struct { unsigned long digits; uint64_t hash; } known[] = {
+    { 1000,    0x84084d8fa08a7800ULL },
+    { 10000,   0x222b1c2d01b8549eULL },
+    { 100000,  0x9c39b891c049f50fULL },
+    { 1000000, 0x6e3b88b8372318f8ULL }
+  };
+
+  static const char* prefix = "31415926535897932384626433832795028841971693993751";
+
+
+  /*
+  * Binary splitting of the Chudnovsky series
+  * Remark: Computes P, Q and T of the terms a <= k < b. P is not needed at
+    the top level, so it is only formed if needp is true.
+  */
+  void split( unsigned long a, unsigned long b, bigintnum* P, bigintnum* Q, bigintnum* T, bool needp )
+  {
+
+    if( b - a == 1 ){
+
+      /* p and a^3 exceed a digit for large a, so they get three */
+      bigint p[3] = { 1, 0, 0 }, q[4] = { 1, 0, 0, 0 }, t[4];
+
+      if( a > 0 ){
+        p[0] = mbiMulDigits( 6*a - 5, 2*a - 1, &p[1] );
+        p[2] = mbiMulLimb( 2, p, p, 6*a - 1 );
+        q[0] = mbiMulDigits( a, a, &q[1] );
+        q[2] = mbiMulLimb( 2, q, q, a );
+        q[3] = mbiMulLimb( 3, q, q, 10939058860032000UL );
+      }
+      t[3] = mbiMulLimb( 3, t, p, 13591409UL + 545140134UL * a );
+
+      mbiNumSet( P, 3, p, false );
+      mbiNumSet( Q, 4, q, false );
+      mbiNumSet( T, 4, t, a % 2 == 1 );
+      return;
+
+    }
+
+    unsigned long m = ( a + b ) / 2;
+    bigintnum P2, Q2, T2;
+    mbiNumInit( &P2, NULL );
+    mbiNumInit( &Q2, NULL );
+    mbiNumInit( &T2, NULL );
+
+    split( a, m, P, Q, T, true );
+    split( m, b, &P2, &Q2, &T2, needp );
+
+    /* T = Q2 T + P T2, P = P P2, Q = Q Q2 */
+    mbiNumMul( T, T, &Q2 );
+    mbiNumMul( &T2, P, &T2 );
+    mbiNumAdd( T, T, &T2 );
+    if( needp ) mbiNumMul( P, P, &P2 );
+    mbiNumMul( Q, Q, &Q2 );
+
+    mbiNumFree( &P2 );
+    mbiNumFree( &Q2 );
+    mbiNumFree( &T2 );
+  }
+
+
+  /*
+  * Powers of ten and their inverses for the radix conversion, one for each
+  * length of the lower parts
+  */
+  typedef struct {
+    unsigned long k;
+    bigintnum power;
+    bigintfloat inverse;
+  } tenpower;
+
+  static tenpower powers[128];
+  static int npowers = 0;
+
+  tenpower* power( unsigned long k )
+  {
+    for( int i = 0; i < npowers; i++ )
+      if( powers[i].k == k ) return &powers[i];
+
+    assert( npowers < 128 );
+    tenpower* p = &powers[npowers++];
+    bigint ten = 10;
+    bigintnum t;
+    mbiNumInit( &t, NULL );
+    mbiNumSet( &t, 1, &ten, false );
+
+    p->k = k;
+    mbiNumInit( &p->power, NULL );
+    mbiNumPow( &p->power, &t, k );
+    mbiFloatInit( &p->inverse, p->power.length + 3, NULL );
+    mbiFloatSetNum( &p->inverse, &p->power );
+    mbiFloatInv( &p->inverse, &p->inverse );
+
+    mbiNumFree( &t );
+    return p;
+  }
+
+  /*
+  * Writes the n decimal digits of x < 10^n, with leading zeros
+  * Remark: Large numbers are split as x = q 10^k + r for k = n/2. q is
+    x times the inverse of 10^k, corrected by at most a few steps.
+  */
+  void decimal( const bigintnum* x, unsigned long n, char* out )
+  {
+
+    if( x->length <= 32 ){
+
+      bigintnum t;
+      mbiNumInit( &t, NULL );
+      mbiNumSet( &t, x->length, x->digits, false );
+
+      while( n > 0 ){
+        bigint r = mbiNumDivLimb( &t, &t, 10000000000000000000UL );
+        for( int i = 0; i < 19 && n > 0; i++, r /= 10 ) out[--n] = '0' + r % 10;
+      }
+
+      mbiNumFree( &t );
+      return;
+
+    }
+
+    unsigned long k = n / 2;
+    tenpower* p = power( k );
+
+    bigintnum q, r, one;
+    bigintfloat f;
+    bigint d = 1;
+    mbiNumInit( &q, NULL );
+    mbiNumInit( &r, NULL );
+    mbiNumInit( &one, NULL );
+    mbiNumSet( &one, 1, &d, false );
+    mbiFloatInit( &f, p->inverse.prec, NULL );
+
+    mbiFloatSetNum( &f, x );
+    mbiFloatMul( &f, &f, &p->inverse );
+    mbiFloatGetNum( &q, &f );
+
+    mbiNumMul( &r, &q, &p->power );
+    mbiNumSub( &r, x, &r );
+    while( r.negative ){
+      mbiNumSub( &q, &q, &one );
+      mbiNumAdd( &r, &r, &p->power );
+    }
+    while( mbiNumCompare( &r, &p->power ) >= 0 ){
+      mbiNumAdd( &q, &q, &one );
+      mbiNumSub( &r, &r, &p->power );
+    }
+
+    decimal( &q, n - k, out );
+    decimal( &r, k, out + n - k );
+
+    mbiNumFree( &q );
+    mbiNumFree( &r );
+    mbiNumFree( &one );
+    mbiFloatFree( &f );
+  }
+
+
+  double seconds( clock_t t1, clock_t t2 )
+  {
+    return (double)( t2 - t1 ) / CLOCKS_PER_SEC;
+  }
+
+
+  int main( int argc, char** argv )
+  {
+
+    unsigned long digits = argc > 1 ? strtoul( argv[1], NULL, 10 ) : 1000000;
+    if( digits < 50 ) digits = 50;
+
+    /* Each term gives log10(640320^3 / 1728) = 14.18 digits */
+    unsigned long terms = (unsigned long)( digits / 14.181647462725477 ) + 2;
+
+    /* The factor 13591409 + 545140134 k of the terms is a single digit */
+    if( terms > ( ULONG_MAX - 13591409UL ) / 545140134UL ){
+      printf( "-- Error: at most %.0f digits\n", ( ( ULONG_MAX - 13591409UL ) / 545140134UL - 2 ) * 14.181647462725477 );
+      return 1;
+    }
+
+    /* Digits in base 2^DIGIT_BITS, with guard digits */
+    bigintlength prec = (bigintlength)( digits * 3.3219280948873623 / DIGIT_BITS ) + 3;
+
+    printf( "Chudnovsky pi benchmark\n\n" );
+    printf( "-- %lu decimal digits, %lu terms, %lu digits in base 2^%u\n", digits, terms, (unsigned long)prec, (unsigned int)DIGIT_BITS );
+
+    clock_t t0, t1, t2, t3;
+
+
+    /*****************************/
+    /* Binary splitting          */
+    /*****************************/
+
+    t0 = clock();
+
+    bigintnum P, Q, T;
+    mbiNumInit( &P, NULL );
+    mbiNumInit( &Q, NULL );
+    mbiNumInit( &T, NULL );
+    split( 0, terms, &P, &Q, &T, false );
+
+    t1 = clock();
+    printf( "-- splitting:  %8.3f s (Q %lu, T %lu digits)\n", seconds( t0, t1 ), (unsigned long)Q.length, (unsigned long)T.length );
+
+
+    /*****************************/
+    /* Final division            */
+    /*****************************/
+
+    /* pi = 426880 sqrt(10005) Q / T */
+    bigintfloat pi, s, f;
+    mbiFloatInit( &pi, prec, NULL );
+    mbiFloatInit( &s, prec, NULL );
+    mbiFloatInit( &f, prec, NULL );
+
+    mbiFloatSetDigit( &s, 10005, false );
+    mbiFloatSqrt( &s, &s );
+    mbiFloatSetNum( &f, &Q );
+    mbiFloatMul( &s, &s, &f );
+    mbiFloatSetDigit( &f, 426880, false );
+    mbiFloatMul( &s, &s, &f );
+    mbiFloatSetNum( &f, &T );
+    mbiFloatDiv( &pi, &s, &f );
+
+    t2 = clock();
+    printf( "-- division:   %8.3f s\n", seconds( t1, t2 ) );
+
+
+    /*****************************/
+    /* Decimal conversion        */
+    /*****************************/
+
+    /* x = floor(pi 10^digits) has digits + 1 decimal digits */
+    bigintnum x, ten;
+    bigint d = 10;
+    mbiNumInit( &x, NULL );
+    mbiNumInit( &ten, NULL );
+    mbiNumSet( &ten, 1, &d, false );
+    mbiNumPow( &x, &ten, digits );
+    mbiFloatSetPrecision( &f, prec + 2 );
+    mbiFloatSetNum( &f, &x );
+    mbiFloatMul( &f, &f, &pi );
+    mbiFloatGetNum( &x, &f );
+
+    char* out = malloc( digits + 2 );
+    assert( out != NULL );
+    decimal( &x, digits + 1, out );
+    out[digits+1] = 0;
+
+    t3 = clock();
+    printf( "-- conversion: %8.3f s\n", seconds( t2, t3 ) );
+    printf( "-- total:      %8.3f s, %.0f digits/s\n", seconds( t0, t3 ), digits / seconds( t0, t3 ) );
+
+
+    /*****************************/
+    /* Checks                    */
+    /*****************************/
+
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for( unsigned long i = 0; i <= digits; i++ ){
+      h ^= (unsigned char)out[i];
+      h *= 0x100000001b3ULL;
+    }
+
+    printf( "-- digits: %.1s.%.20s...%s\n", out, out + 1, out + digits - 19 );
+    printf( "-- hash: %016llx", (unsigned long long)h );
+
+    int result = 0;
+    if( strncmp( out, prefix, strlen( prefix ) ) != 0 ){
+      printf( "\n-- Error: the leading digits are wrong\n" );
+      result = 1;
+    }else{
+      bool checked = false;
+      for( unsigned int i = 0; i < sizeof(known)/sizeof(known[0]); i++ )
+        if( known[i].digits == digits ){
+          checked = true;
+          if( known[i].hash == h ){
+            printf( " ok\n" );
+          }else{
+            printf( "\n-- Error: the digits do not match the known hash %016llx\n", (unsigned long long)known[i].hash );
+            result = 1;
+          }
+        }
+      if( !checked ) printf( " (no known hash)\n" );
+    }
+
+    free( out );
+    mbiNumFree( &P );
+    mbiNumFree( &Q );
+    mbiNumFree( &T );
+    mbiNumFree( &x );
+    mbiNumFree( &ten );
+    mbiFloatFree( &pi );
+    mbiFloatFree( &s );
+    mbiFloatFree( &f );
+    for( int i = 0; i < npowers; i++ ){
+      mbiNumFree( &powers[i].power );
+      mbiFloatFree( &powers[i].inverse );
+    }
+
+    return result;
+
+  }
+